@@ -1 +1,288 @@
+#include <cstddef>   // size_t
+#include <vector>    // std::vector: push_back(), reserve(), clear()
+#include <algorithm> // std::min(), std::max(), std::sort(), std::lower_bound()
+#include <limits>    // std::numeric_limits
+
 #include "Where_condition.h"
+
+
+void Where_condition::filter(const Table &table, std::vector<size_t> &rows)
+{
+    const size_t size = table.size();
+    rows.clear();
+
+    if (expr.empty()) { // WHERE ALL
+        rows.reserve(size);
+        for (size_t i = 0; i < size; ++i) {
+            if (!table.is_deleted(i))
+                rows.push_back(i);
+        }
+        return;
+    }
+
+    const object_type type = expr.bind(table);
+    match_dictionary(table, type);
+    size_t batch[Expression::BATCH_SIZE]; // номера строк текущего прохода
+
+    std::vector<size_t> candidates;
+    if (index_lookup(table, type, candidates)) {
+        // условие проверяется только на строках, найденных по индексу
+        for (size_t begin = 0; begin < candidates.size(); begin += Expression::BATCH_SIZE) {
+            check(candidates.data() + begin, std::min(Expression::BATCH_SIZE, candidates.size() - begin),
+                  type, rows);
+        }
+        return;
+    }
+
+    std::vector<std::pair<const std::vector<Table::Zone> *, Expression::Term>> checks;
+    zone_checks(table, checks);
+
+    for (size_t block = 0; block * Table::BLOCK_SIZE < size; ++block) {
+        if (!block_may_match(block, checks)) { // по min/max блока ни одна строка не подходит
+            continue;
+        }
+        const size_t block_end = std::min((block + 1) * Table::BLOCK_SIZE, size);
+        for (size_t begin = block * Table::BLOCK_SIZE; begin < block_end; begin += Expression::BATCH_SIZE) {
+            const size_t end = std::min(begin + Expression::BATCH_SIZE, block_end);
+            size_t count = 0;
+            if (table.has_deleted()) {
+                for (size_t row = begin; row < end; ++row) { // удалённые строки пропускаем по битовой карте
+                    batch[count] = row;
+                    count += !table.is_deleted(row);
+                }
+            } else {
+                for (size_t row = begin; row < end; ++row) {
+                    batch[count++] = row;
+                }
+            }
+            if (count != 0) {
+                check(batch, count, type, rows);
+            }
+        }
+    }
+}
+
+
+void Where_condition::zone_checks(const Table &table,
+                                  std::vector<std::pair<const std::vector<Table::Zone> *, Expression::Term>> &checks)
+{
+    if (exist_pattern || not_lex) {
+        return;
+    }
+    if (!compare_set.empty()) { // <поле LONG> IN (<константы>): блок проверяется по всему списку
+        std::string column = expr.column_name();
+        const std::vector<Table::Zone> *zones = column.empty() ? nullptr : table.zones(column);
+        if (zones != nullptr && !long_compare_set.empty()) {
+            sorted_constants = long_compare_set.values();
+            std::sort(sorted_constants.begin(), sorted_constants.end());
+            Expression::Term term;
+            term.column = column;
+            term.operation = OP_EQUAL; // признак проверки списка IN
+            term.type = NONE;
+            checks.emplace_back(zones, term);
+        }
+        return;
+    }
+
+    std::vector<Expression::Term> terms;
+    expr.terms(terms);
+    for (const auto &term : terms) {
+        if (term.type == LONG) {
+            checks.emplace_back(table.zones(term.column), term);
+        }
+    }
+}
+
+
+bool Where_condition::block_may_match(size_t block, const std::vector<std::pair<const std::vector<Table::Zone> *,
+                                                                                Expression::Term>> &checks) const
+{
+    for (const auto &check : checks) {
+        if (block >= check.first->size()) {
+            continue;
+        }
+        const Table::Zone &zone = (*check.first)[block];
+        const int64_t value = check.second.number;
+        bool may_match = true;
+        switch (check.second.operation) {
+            case OP_EQUAL:
+                if (check.second.type == NONE) { // список IN: есть ли константа в [min, max]
+                    auto it = std::lower_bound(sorted_constants.begin(), sorted_constants.end(), zone.min);
+                    may_match = it != sorted_constants.end() && *it <= zone.max;
+                } else {
+                    may_match = zone.min <= value && value <= zone.max;
+                }
+                break;
+            case OP_NOT_EQUAL:
+                may_match = !(zone.min == value && zone.max == value);
+                break;
+            case OP_LESS:
+                may_match = zone.min < value;
+                break;
+            case OP_LESS_OR_EQUAL:
+                may_match = zone.min <= value;
+                break;
+            case OP_GREATER:
+                may_match = zone.max > value;
+                break;
+            case OP_GREATER_OR_EQUAL:
+                may_match = zone.max >= value;
+                break;
+            default:
+                break;
+        }
+        if (!may_match) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool Where_condition::index_lookup(const Table &table, object_type type, std::vector<size_t> &candidates)
+{
+    if (not_lex || exist_pattern) { // NOT IN и LIKE индексом не ускоряются
+        return false;
+    }
+
+    if (!compare_set.empty()) { // <поле> IN (<константы>)
+        const Hash_index *index = table.hash_index(expr.column_name());
+        if (index == nullptr) {
+            return false;
+        }
+        if (type == LONG) {
+            for (int64_t value : long_compare_set.values()) {
+                index->find(value, candidates);
+            }
+        } else {
+            for (const Short_string &value : compare_set.values()) {
+                index->find(value.view(), candidates);
+            }
+        }
+    } else { // <поле> = <константа> [AND ...]
+        std::vector<Expression::Term> terms;
+        expr.terms(terms);
+        const Hash_index *index = nullptr;
+        for (const auto &term : terms) {
+            if (term.operation == OP_EQUAL && (index = table.hash_index(term.column)) != nullptr) {
+                if (term.type == LONG) {
+                    index->find(term.number, candidates);
+                } else {
+                    index->find(term.text, candidates);
+                }
+                break;
+            }
+        }
+        if (index == nullptr && !range_lookup(table, terms, candidates)) {
+            return false;
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end()); // сохраняем порядок строк таблицы
+    return true;
+}
+
+
+bool Where_condition::range_lookup(const Table &table, const std::vector<Expression::Term> &terms,
+                                   std::vector<size_t> &candidates)
+{
+    for (const auto &term : terms) {
+        const Btree_index *index = term.type == LONG ? table.ordered_index(term.column) : nullptr;
+        if (index == nullptr) {
+            continue;
+        }
+        // сужаем диапазон [low, high] всеми условиями на это поле
+        int64_t low = std::numeric_limits<int64_t>::min(), high = std::numeric_limits<int64_t>::max();
+        bool bounded = false;
+        for (const auto &bound : terms) {
+            if (bound.column != term.column) {
+                continue;
+            }
+            bounded |= bound.operation != OP_NOT_EQUAL;
+            switch (bound.operation) {
+                case OP_EQUAL:
+                    low = std::max(low, bound.number);
+                    high = std::min(high, bound.number);
+                    break;
+                case OP_GREATER:
+                    if (bound.number == std::numeric_limits<int64_t>::max()) {
+                        return true; // пустой диапазон
+                    }
+                    low = std::max(low, bound.number + 1);
+                    break;
+                case OP_GREATER_OR_EQUAL:
+                    low = std::max(low, bound.number);
+                    break;
+                case OP_LESS:
+                    if (bound.number == std::numeric_limits<int64_t>::min()) {
+                        return true;
+                    }
+                    high = std::min(high, bound.number - 1);
+                    break;
+                case OP_LESS_OR_EQUAL:
+                    high = std::min(high, bound.number);
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (bounded) {
+            index->range(low, high, candidates);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void Where_condition::match_dictionary(const Table &table, object_type type)
+{
+    dictionary_column = nullptr;
+    const std::string column_name = expr.column_name();
+    if ((!exist_pattern && compare_set.empty()) || type != TEXT || column_name.empty()) {
+        return;
+    }
+    const Table::Column &column = table.table.at(column_name);
+    if (!column.encoded) {
+        return;
+    }
+
+    dictionary_column = &column;
+    dictionary_matches.resize(column.dictionary.size());
+    for (size_t code = 0; code < dictionary_matches.size(); ++code) {
+        dictionary_matches[code] = condition(Short_string(column.dictionary[code]));
+    }
+}
+
+
+void Where_condition::check(const size_t *batch, size_t count, object_type type, std::vector<size_t> &rows)
+{
+    if (dictionary_column != nullptr) { // условие уже вычислено по словарю: проверяем только коды
+        const uint32_t *codes = dictionary_column->codes.data();
+        for (size_t i = 0; i < count; ++i) {
+            if (dictionary_matches[codes[batch[i]]])
+                rows.push_back(batch[i]);
+        }
+        return;
+    }
+
+    const bool logical = !exist_pattern && compare_set.empty(); // иначе LIKE или IN
+    expr.evaluate(batch, count);
+
+    if (logical) {
+        for (size_t i = 0; i < count; ++i) {
+            if (expr.long_result(i))
+                rows.push_back(batch[i]);
+        }
+    } else if (type == LONG) {
+        for (size_t i = 0; i < count; ++i) {
+            if (condition(expr.long_result(i)))
+                rows.push_back(batch[i]);
+        }
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            if (condition(expr.text_result(i)))
+                rows.push_back(batch[i]);
+        }
+    }
+}
@@ -1,77 +1,125 @@
-
 #ifndef SQL_INTERPRETER_WHERE_CONDITION_H
 #define SQL_INTERPRETER_WHERE_CONDITION_H
 
 
+#include <cstdint>
+#include <cstddef>
 #include <string>
-#include <regex>
-#include <set>
-
+#include <string_view>
+#include <deque>
+#include <vector>
+#include <utility>
+#include "table.h"
+#include "expression.h"
+#include "like.h"
+#include "flat_set.h"
 
-#define _LESS 0
-#define _EQ_LESS 1
-#define _MORE 2
-#define _EQ_MORE 2
 
 class Where_condition
 {
 public:
-    bool condition(const std::string &value)
+    /**
+     * [condition: checks a single value of the left part of LIKE / IN]
+     */
+    bool condition(const Short_string &value)
     {
-        if ((!compare_set.empty()) xor not_lex)
-            return compare_set.find(value) != compare_set.end();
+        bool result = true;
         if (exist_pattern) {
-            return std::regex_match(value, pattern);
+            result = pattern.match(value.view());
+        } else if (!compare_set.empty()) {
+            result = compare_set.contains(value);
         }
-//        if(!expr.empty()){
-//            return count_expr(expr, value);
-//        }
-        return true;
+        return result != not_lex;
+    }
+
+    bool condition(int64_t value)
+    {
+        bool result = true;
+        if (!compare_set.empty()) {
+            // в списке могут быть только константы TEXT: тогда с числом не совпадает ни одна
+            result = long_compare_set.contains(value);
+        }
+        return result != not_lex;
     }
 
     void set_set(const std::string &value)
     {
-        compare_set.insert(value);
+        constants.push_back(value);
+        compare_set.insert(Short_string(constants.back()));
+        // числовые константы сразу храним в типизированном виде для полей LONG
+        if (!value.empty() && value.find_first_not_of("0123456789") == std::string::npos)
+            long_compare_set.insert(to_long(value));
     }
 
     void set_pattern(const std::string &pattern)
     {
-        std::string reg_pattern;
-        // перевожу sql'ные регулярки в человеческие
-        for (char letter : pattern) {
-            if (letter == '%') {
-                reg_pattern += '*';
-                continue;
-            }
-            if (letter == '_') {
-                reg_pattern += ".";
-                continue;
-            }
-            reg_pattern += letter;
-        }
-        this->pattern = reg_pattern;
+        this->pattern = Like_pattern(pattern); // шаблон разбирается один раз, а не на каждой строке
         exist_pattern = true;
     }
 
-//    void set_logical_exp(Identifier item)
-//    {
-//        expr.push_back(item);
-//    }
+    void set_logical_exp(operation_type operation, const std::string &value)
+    {
+        expr.push(operation, value);
+    }
 
     void set_not()
     {
         not_lex = true;
     }
+
+    /**
+     * [filter: writes to <rows> the numbers of the rows of <table> satisfying the condition]
+     * [        (the condition is evaluated once per row, in batches of BATCH_SIZE rows)   ]
+     */
+    void filter(const Table &table, std::vector<size_t> &rows);
+
 private:
-    std::set<std::string> compare_set;
+    /**
+     * [index_lookup: if the condition can be answered by an index of <table>, writes the]
+     * [              candidate rows to <candidates> in ascending order and returns true]
+     */
+    bool index_lookup(const Table &table, object_type type, std::vector<size_t> &candidates);
+
+    /**
+     * [range_lookup: answers the range conditions <terms> by a B+-tree index of <table>]
+     */
+    bool range_lookup(const Table &table, const std::vector<Expression::Term> &terms,
+                      std::vector<size_t> &candidates);
+
+    /**
+     * [zone_checks: collects the conditions that allow skipping blocks by their min/max]
+     */
+    void zone_checks(const Table &table, std::vector<std::pair<const std::vector<Table::Zone> *,
+                                                               Expression::Term>> &checks);
+
+    /**
+     * [block_may_match: returns false if no row of the block <block> can satisfy <checks>]
+     */
+    bool block_may_match(size_t block, const std::vector<std::pair<const std::vector<Table::Zone> *,
+                                                                   Expression::Term>> &checks) const;
+
+    /**
+     * [match_dictionary: for LIKE / IN over a dictionary-encoded field evaluates]
+     * [                  the condition once per dictionary entry              ]
+     */
+    void match_dictionary(const Table &table, object_type type);
+
+    /**
+     * [check: evaluates the condition for <count> rows <batch>, appends matching ones to <rows>]
+     */
+    void check(const size_t *batch, size_t count, object_type type, std::vector<size_t> &rows);
+
+    std::deque<std::string> constants;         // константы списка IN (на них ссылается <compare_set>)
+    Flat_set<Short_string> compare_set;        // список IN для полей TEXT
+    Flat_set<int64_t> long_compare_set;        // список IN для полей LONG
+    std::vector<int64_t> sorted_constants;     // <long_compare_set> по возрастанию (для min/max блоков)
     bool not_lex = false;
-    std::regex pattern;
+    Like_pattern pattern;
     bool exist_pattern = false;
-//    std::vector<Identifier> expr;
-//
-//    bool count_expr(std::vector<Identifier>, std::string value){
-//
-//    }
+    Expression expr; // логическое выражение или левая часть LIKE / IN
+
+    const Table::Column *dictionary_column = nullptr; // поле-словарь в левой части LIKE / IN
+    std::vector<char> dictionary_matches;             // результат условия для каждого кода словаря
 };
 
 
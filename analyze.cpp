@@ -1,16 +1,20 @@
 #include <iostream>  // std::cout, std::endl, std::ostream
 #include <string>    // std::string: push_back(), size(), clear()
 #include <iomanip>   // std::setw(), std::left
-#include <utility>   // std::pair
+#include <utility>   // std::pair, std::move()
 #include <vector>    // std::vector: emplace_pack(), push_back(), size(), begin(), end(), clear()
 #include <stack>     // std::stack: push(), top(), pop(), clear()
 #include <set>       // std::set<std::string>: insert(), clear()
 #include <iterator>  // std::iterator
 #include <sstream>   // std::istringstream: putback(), get()
-#include <algorithm> // find()
+#include <algorithm> // find(), find_if(), reverse()
 #include <ctype.h>   // isspace(), isalpha(), isdigit()
       // functions for semantic analysis and for working with tables
 #include "exception.h" // AnalyzeError(), std::exception
+#include "storage.h"   // checkpoint_database()
+#include "wal.h"       // wal: append()
+#include "mapped.h"    // Mapped_file
+#include "csv.h"       // import_path()
 
 
 #include "analyze.h" // прототипы всех функций, описанных в этом файле
@@ -22,7 +26,7 @@
 #define SYNTAX   ACTIVATE /* синтаксический анализ: без LEXICAL ACTIVATE не запустится */
 #define SEMANTIC ACTIVATE /* семантический анализ: без SYNTAX ACTIVATE не запустится */
 #define EXECUTOR ACTIVATE /* исполнение запроса: без SEMANTIC ACTIVATE не запустится */
-#define DEBUG    ACTIVATE /* отладочная печать */
+#define DEBUG    OFF      /* отладочная печать */
 
 
 /* -------------------- class Identifier -------------------- */
@@ -55,7 +59,9 @@ const char *Analyze::TABLE_OF_LEXEME[] =
         {
                 "LEX_NULL", "LEX_SELECT", "LEX_FROM", "LEX_INSERT", "LEX_INTO", "LEX_UPDATE", "LEX_SET",
                 "LEX_DELETE", "LEX_CREATE", "LEX_TABLE", "LEX_TEXT", "LEX_LONG", "LEX_DROP", "LEX_WHERE",
-                "LEX_NOT", "LEX_LIKE", "LEX_IN", "LEX_AND", "LEX_OR", "LEX_ALL", "LEX_FIN", "LEX_COMMA",
+                "LEX_NOT", "LEX_LIKE", "LEX_IN", "LEX_AND", "LEX_OR", "LEX_ALL", "LEX_INDEX", "LEX_ON",
+                "LEX_USING", "LEX_HASH", "LEX_BTREE", "LEX_VALUES", "LEX_COPY", "LEX_CHECKPOINT", "LEX_BACKGROUND",
+                "LEX_FIN", "LEX_COMMA",
                 "LEX_STAR", "LEX_QUOTE", "LEX_OPEN_BRACKET", "LEX_CLOSE_BRACKET", "LEX_PLUS", "LEX_MINUS",
                 "LEX_SLASH", "LEX_PERCENT", "LEX_EQUAL", "LEX_GREATER", "LEX_LESS", "LEX_GREATER_OR_EQUAL",
                 "LEX_LESS_OR_EQUAL", "LEX_NOT_EQUAL", "LEX_NUM", "LEX_ID", "LEX_STRING", nullptr
@@ -64,65 +70,83 @@ const char *Analyze::TABLE_OF_LEXEME[] =
 const char *Analyze::TABLE_OF_KEYWORDS[] =
         {
                 "SELECT", "FROM", "INSERT", "INTO", "UPDATE", "SET", "DELETE", "CREATE", "TABLE",
-                "TEXT", "LONG", "DROP", "WHERE", "NOT", "LIKE", "IN", "AND", "OR", "ALL", nullptr
+                "TEXT", "LONG", "DROP", "WHERE", "NOT", "LIKE", "IN", "AND", "OR", "ALL", "INDEX", "ON", "USING",
+                "HASH", "BTREE", "VALUES", "COPY", "CHECKPOINT", "BACKGROUND", nullptr
         };
 
 const char *Analyze::TABLE_OF_DELIMS[] =
         {
-                ";", ",", "*", "\'", "(", ")", "+", "-", "/", "%", "=", ">", "<", "<=", ">=", nullptr
+                ";", ",", "*", "\'", "(", ")", "+", "-", "/", "%", "=", ">", "<", ">=", "<=", nullptr
         };
 
-int Analyze::table_access_key;
+const std::string Analyze::COPY_DATA = " FROM DATA;\n";
 
-std::string Analyze::command;
-
-std::vector<Identifier> Analyze::TID;
+Analyze::Analyze(int key) : table_access_key(key)
+{}
 
-std::vector<Identifier> Analyze::POLIS;
 
-std::vector<Identifier> Analyze::TOKENS;
+Analyze::Analyze(int key, const std::string &query) : table_access_key(key), command(query)
+{}
 
-Table Analyze::selected_table = Table(); //todo constructor with name for this table
 
-bool  Analyze::table_is_actual = false;
+std::string Analyze::get_table_text(){
+    return table_is_actual? selected_table.to_string(): "";
+}
 
 
-Analyze::Analyze(int key, const std::string &query)
+const Table_view *Analyze::get_table_view() const
 {
-    Analyze::table_access_key = key;
-    Analyze::command = query;
-    /* инициализация в теле цикла, т.к. переменные статические */
+    return table_is_actual? &selected_table: nullptr;
 }
 
-std::string Analyze::get_table_text(){
-    return Analyze::table_is_actual? selected_table.to_string(): "";
+
+uint64_t Analyze::get_commit_lsn() const
+{
+    return commit_lsn;
 }
 
 
-Analyze::~Analyze()
+void Analyze::start(const std::string &query)
 {
-    // отчищаем статический члены класса:
-    Analyze::command.clear(); // буфер команды
-    Analyze::TOKENS.clear();  // таблицу токенов
-    Analyze::POLIS.clear();   // таблицу ПОЛИЗа
-    Analyze::TID.clear();     // таблицу идентификаторов
+    // буферы сеанса очищаются, но их память переиспользуется следующей командой
+    command.assign(query);
+    TOKENS.clear();
+    POLIS.clear();
+    TID.clear();
+    start();
 }
 
 
 void Analyze::start()
 {
+    statement_lock.unlock(); // результат предыдущей команды больше не нужен
+    commit_lsn = 0;
 #if DEBUG
-    std::cout << "command:\n" << Analyze::command << std::endl;
+    std::cout << "command:\n" << command << std::endl;
 #endif
 
 #if LEXICAL
-    Scanner().lexical_analyze();      // запускаем лексический анализатор
+    Scanner(*this).lexical_analyze();      // запускаем лексический анализатор
+    try {
+        // таблица блокируется до разбора: проверки семантики и исполнение видят одно её состояние
+        lock_tables();
 #if SYNTAX
-    Parser().syntactic_analyze(); // запускаем синтаксический + семантический анализатор
+        Parser(*this).syntactic_analyze(); // запускаем синтаксический + семантический анализатор
 #if SEMANTIC && EXECUTOR
-    Executor().interpreter(); // запускаем перевод в ПОЛИЗ + исполнитель запроса
+        Executor(*this).interpreter(); // запускаем перевод в ПОЛИЗ + исполнитель запроса
+        // изменение попадает в журнал, пока таблица ещё заблокирована: порядок записей = порядок изменений
+        // (COPY пишет в журнал свои данные сам, см. copy_values())
+        if (TOKENS[0].ident_type != LEX_SELECT && TOKENS[0].ident_type != LEX_CHECKPOINT &&
+            TOKENS[0].ident_type != LEX_COPY) {
+            commit_lsn = wal.append(command);
+        }
 #endif
 #endif
+    }
+    catch (...) {
+        statement_lock.unlock();
+        throw;
+    }
 #if DEBUG
     std::cout << "Analyze succeeded" << std::endl;
 #endif
@@ -130,14 +154,76 @@ void Analyze::start()
 }
 
 
+void Analyze::release()
+{
+    statement_lock.unlock();
+}
+
+
+void Analyze::replay(std::string_view record, std::string_view data)
+{
+    // COPY записан вместе со строками файла: "COPY <table_name> FROM DATA;\n<CSV>"
+    const size_t end = record.compare(0, 5, "COPY ") == 0 ? record.find(' ', 5) : std::string::npos;
+    if (end != std::string::npos && record.compare(end, COPY_DATA.size(), COPY_DATA) == 0) {
+        const std::string table_name(record.substr(5, end - 5));
+        statement_lock.unlock();
+        statement_lock.lock(table_access_key, table_name, Table_lock::WRITE);
+        try {
+            // строки копируются из самой записи или из файла данных журнала, без промежуточной копии
+            copy_into_table(table_access_key, table_name, data.empty() ? record.substr(end + COPY_DATA.size()) : data);
+        }
+        catch (...) {
+            statement_lock.unlock();
+            throw;
+        }
+        statement_lock.unlock();
+        return;
+    }
+    start(std::string(record));
+    release();
+}
+
+
+void Analyze::lock_tables()
+{
+    // имя таблицы берём из первых лексем; если команда записана неверно, её отвергнет Parser
+    Table_lock::lock_mode mode = Table_lock::WRITE;
+    size_t name_pos = 0;
+    switch (TOKENS[0].ident_type) {
+        case LEX_SELECT:
+            mode = Table_lock::READ;
+            for (size_t i = 1; i + 1 < TOKENS.size(); ++i) {
+                if (TOKENS[i].ident_type == LEX_FROM) {
+                    name_pos = i + 1;
+                    break;
+                }
+            }
+            break;
+        case LEX_INSERT: // INSERT INTO <table>
+        case LEX_DELETE: // DELETE FROM <table>
+            name_pos = 2;
+            break;
+        case LEX_UPDATE: // UPDATE <table>
+        case LEX_COPY:   // COPY <table>
+            name_pos = 1;
+            break;
+        default:         // CREATE, DROP: меняется набор таблиц или индексов
+            mode = Table_lock::CATALOG;
+            break;
+    }
+    std::string table_name = name_pos != 0 && name_pos < TOKENS.size() ? TOKENS[name_pos].ident_name : "";
+    statement_lock.lock(table_access_key, table_name, mode);
+}
+
+
 /* --------------------- class Scanner --------------------- */
 
-Analyze::Scanner::Scanner() : sin(Analyze::command)
+Analyze::Scanner::Scanner(Analyze &analyze) : analyze(analyze), sin(analyze.command)
 {
     // сразу проверяем завершающий символ
-    if (Analyze::command.back() != ';') {
+    if (analyze.command.empty() || analyze.command.back() != ';') {
         throw AnalyzeError("LEXICAL ERROR: no semicolon at the end of the query",
-                           Analyze::command, ";");
+                           analyze.command, ";");
     }
 }
 
@@ -150,8 +236,6 @@ const Identifier Analyze::Scanner::get_lex()
     } current_state = START;
     std::string lex;
     int pos;
-    static bool is_first_quote = false;
-    static bool is_second_quote = false;
     std::string error_description = "LEXICAL ERROR: ";
 
     while (true) {
@@ -300,7 +384,7 @@ const Identifier Analyze::Scanner::get_lex()
                     lex.push_back(c);
                     get_char();
                 }
-                throw AnalyzeError(error_description, Analyze::command, lex);
+                throw AnalyzeError(error_description, analyze.command, lex);
         }
     }
 }
@@ -327,12 +411,12 @@ int Analyze::Scanner::put_to_TID(const std::string &lex)
 {
     std::vector<Identifier>::iterator k;
 
-    if ((k = std::find(Analyze::TID.begin(), Analyze::TID.end(), lex)) != Analyze::TID.end()) {
-        return k - Analyze::TID.begin(); // ищём в TID лексему <lex>; возвращаем позицию
+    if ((k = std::find(analyze.TID.begin(), analyze.TID.end(), lex)) != analyze.TID.end()) {
+        return k - analyze.TID.begin(); // ищём в TID лексему <lex>; возвращаем позицию
     }
 
-    Analyze::TID.emplace_back(LEX_ID, lex); // иначе заносим лексему в TID
-    return Analyze::TID.size() - 1;
+    analyze.TID.emplace_back(LEX_ID, lex); // иначе заносим лексему в TID
+    return analyze.TID.size() - 1;
 }
 
 void Analyze::Scanner::print_TABLE(std::vector<Identifier> TABLE, const char *table_name)
@@ -355,23 +439,24 @@ void Analyze::Scanner::lexical_analyze()
     Identifier current_ID; // текущая лексема
 
     do {
-        current_ID = get_lex();                // формируем новую лексему + заполняем Analyze::TID
-        Analyze::TOKENS.push_back(current_ID); // заполняем Analyze::TOKENS
+        current_ID = get_lex();                // формируем новую лексему + заполняем analyze.TID
+        analyze.TOKENS.push_back(current_ID); // заполняем analyze.TOKENS
     } while (current_ID.ident_type != LEX_FIN);
 #if DEBUG
-    Analyze::Scanner::print_TABLE(Analyze::TOKENS, "TOKENS");
+    Analyze::Scanner::print_TABLE(analyze.TOKENS, "TOKENS");
 #endif
 }
 
 
 /* ---------------------- class Parser ---------------------- */
 
-Analyze::Parser::Parser() = default;
+Analyze::Parser::Parser(Analyze &analyze) : analyze(analyze)
+{}
 
 
 inline void Analyze::Parser::get_lex()
 {
-    current_lex = Analyze::TOKENS[pos++];
+    current_lex = analyze.TOKENS[pos++];
 }
 
 
@@ -387,7 +472,7 @@ void Analyze::Parser::syntactic_analyze()
     // проверяем завершающий символ
     if (current_lex.ident_type != LEX_FIN) {
         throw AnalyzeError("SYNTAX ERROR: expected token ;",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
 }
 
@@ -411,9 +496,17 @@ void Analyze::Parser::SQL()
     } else if (current_lex.ident_type == LEX_DROP) {
         get_lex();
         DROP();   //   DROP_preposition
+    } else if (current_lex.ident_type == LEX_COPY) {
+        get_lex();
+        COPY();   //   COPY_preposition
+    } else if (current_lex.ident_type == LEX_CHECKPOINT) {
+        get_lex(); // CHECKPOINT [BACKGROUND]: все таблицы записываются на диск
+        if (current_lex.ident_type == LEX_BACKGROUND) {
+            get_lex();
+        }
     } else {
-        throw AnalyzeError("SYNTAX ERROR: expected token SELECT|INSERT|UPDATE|DELETE|CREATE|DROP",
-                           Analyze::command, current_lex.ident_name);
+        throw AnalyzeError("SYNTAX ERROR: expected token SELECT|INSERT|UPDATE|DELETE|CREATE|DROP|COPY|CHECKPOINT",
+                           analyze.command, current_lex.ident_name);
     }
 }
 
@@ -429,9 +522,9 @@ void Analyze::Parser::SELECT()
     table_name();
 #if SEMANTIC
     for (const auto &field_name : obj_list) {
-        if (!object_exist(Analyze::table_access_key, table_head, field_name)) {
+        if (!object_exist(analyze.table_access_key, table_head, field_name)) {
             throw AnalyzeError("SEMANTIC ERROR: this field does not exist in the specified table",
-                               Analyze::command, field_name);
+                               analyze.command, field_name);
         }
     }
 #endif
@@ -457,7 +550,7 @@ void Analyze::Parser::object_name()
 {
     if (current_lex.ident_type != LEX_ID) {
         throw AnalyzeError("SYNTAX ERROR: expected token ID",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
 #if SEMANTIC
     /**
@@ -469,7 +562,7 @@ void Analyze::Parser::object_name()
      */
     if (!obj_list.insert(current_lex.ident_name).second) {
         throw AnalyzeError("SEMANTIC ERROR: repeated description",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
 #endif
     get_lex();
@@ -479,7 +572,7 @@ void Analyze::Parser::FROM()
 {
     if (current_lex.ident_type != LEX_FROM) {
         throw AnalyzeError("SYNTAX ERROR: expected token FROM",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -488,12 +581,12 @@ void Analyze::Parser::table_name()
 {
     if (current_lex.ident_type != LEX_ID) {
         throw AnalyzeError("SYNTAX ERROR: expected token ID",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
 #if SEMANTIC
-    if (!table_exist(Analyze::table_access_key, current_lex.ident_name)) {
+    if (!table_exist(analyze.table_access_key, current_lex.ident_name)) {
         throw AnalyzeError("SEMANTIC ERROR: table with the given name does not exist",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     table_head = current_lex.ident_name;
 #endif
@@ -509,23 +602,33 @@ void Analyze::Parser::INSERT()
     INTO();
     table_name();
 
-    open_bracket();
-
-    object_value();
-    while (current_lex.ident_type == LEX_COMMA) {
+    if (current_lex.ident_type == LEX_VALUES) { // VALUES необязательно
         get_lex();
-        object_value();
     }
+    // одной командой можно вставить несколько записей: (...), (...), ...
+    while (true) {
+        open_bracket();
 
-    close_bracket();
+        object_value();
+        while (current_lex.ident_type == LEX_COMMA) {
+            get_lex();
+            object_value();
+        }
+
+        close_bracket();
+        if (current_lex.ident_type != LEX_COMMA) {
+            break;
+        }
+        get_lex();
+    }
 
 #if SEMANTIC
     try {
-        check_param(table_access_key, table_head, actual_param);
+        check_param(analyze.table_access_key, table_head, actual_param);
     }
     catch (std::exception &err) {
         throw AnalyzeError(std::string("SEMANTIC ERROR: ") + err.what(),
-                           Analyze::command, "(");
+                           analyze.command, "(");
     }
 #endif
     actual_param.clear();
@@ -535,7 +638,7 @@ void Analyze::Parser::INTO()
 {
     if (current_lex.ident_type != LEX_INTO) {
         throw AnalyzeError("SYNTAX ERROR: expected token INTO",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -544,7 +647,7 @@ void Analyze::Parser::open_bracket()
 {
     if (current_lex.ident_type != LEX_OPEN_BRACKET) {
         throw AnalyzeError("SYNTAX ERROR: expected token OPEN_BRACKET",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -553,7 +656,7 @@ void Analyze::Parser::close_bracket()
 {
     if (current_lex.ident_type != LEX_CLOSE_BRACKET) {
         throw AnalyzeError("SYNTAX ERROR: expected token CLOSE_BRACKET",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -568,7 +671,7 @@ void Analyze::Parser::object_value()
         string();
     } else {
         throw AnalyzeError("SYNTAX ERROR: expected token STRING | long_integer",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
 }
 
@@ -576,19 +679,19 @@ void Analyze::Parser::string()
 {
     if (current_lex.ident_type != LEX_QUOTE) {
         throw AnalyzeError("SYNTAX ERROR: expected token \'",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 
     if (current_lex.ident_type != LEX_STRING) {
         throw AnalyzeError("SYNTAX ERROR: expected token STRING",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 
     if (current_lex.ident_type != LEX_QUOTE) {
         throw AnalyzeError("SYNTAX ERROR: expected token \'",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -606,18 +709,18 @@ void Analyze::Parser::UPDATE()
     std::string obj_name = *(obj_list.begin());
 
 #if SEMANTIC
-    if (!object_exist(table_access_key, table_head, obj_name)) {
+    if (!object_exist(analyze.table_access_key, table_head, obj_name)) {
         throw AnalyzeError("SEMANTIC ERROR: this field does not exist in the specified table",
-                           Analyze::command, obj_name);
+                           analyze.command, obj_name);
     }
 #endif
 
     EQUAL();
 
 #if SEMANTIC
-    if (get_object_type(table_access_key, table_head, obj_name) != expression()) {
+    if (get_object_type(analyze.table_access_key, table_head, obj_name) != expression()) {
         throw AnalyzeError("SEMANTIC ERROR: type mismatch",
-                           Analyze::command, obj_name);
+                           analyze.command, obj_name);
     }
 #else
     expression();
@@ -631,7 +734,7 @@ void Analyze::Parser::SET()
 {
     if (current_lex.ident_type != LEX_SET) {
         throw AnalyzeError("SYNTAX ERROR: expected token SET",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -640,7 +743,7 @@ void Analyze::Parser::EQUAL()
 {
     if (current_lex.ident_type != LEX_EQUAL) {
         throw AnalyzeError("SYNTAX ERROR: expected token =",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -662,6 +765,34 @@ void Analyze::Parser::DELETE()
 void Analyze::Parser::CREATE()
 {
     /* CREATE */
+    if (current_lex.ident_type == LEX_INDEX) {
+        get_lex();
+        new_index_name();
+        ON();
+        table_name();
+        open_bracket();
+        object_name();
+        std::string obj_name = *(obj_list.begin());
+#if SEMANTIC
+        if (!object_exist(analyze.table_access_key, table_head, obj_name)) {
+            throw AnalyzeError("SEMANTIC ERROR: this field does not exist in the specified table",
+                               analyze.command, obj_name);
+        }
+#endif
+        close_bracket();
+#if SEMANTIC
+        if (index_type() == LEX_BTREE &&
+            get_object_type(analyze.table_access_key, table_head, obj_name) != LONG) {
+            throw AnalyzeError("SEMANTIC ERROR: type mismatch, BTREE index requires a LONG field",
+                               analyze.command, obj_name);
+        }
+#else
+        index_type();
+#endif
+        obj_list.clear();
+        return;
+    }
+
     TABLE();
     new_table_name();
     open_bracket();
@@ -669,11 +800,50 @@ void Analyze::Parser::CREATE()
     close_bracket();
 }
 
+void Analyze::Parser::new_index_name()
+{
+    if (current_lex.ident_type != LEX_ID) {
+        throw AnalyzeError("SYNTAX ERROR: expected token ID",
+                           analyze.command, current_lex.ident_name);
+    }
+#if SEMANTIC
+    if (index_exist(analyze.table_access_key, current_lex.ident_name)) {
+        throw AnalyzeError("SEMANTIC ERROR: index with the given name already exist",
+                           analyze.command, current_lex.ident_name);
+    }
+#endif
+    get_lex();
+}
+
+void Analyze::Parser::ON()
+{
+    if (current_lex.ident_type != LEX_ON) {
+        throw AnalyzeError("SYNTAX ERROR: expected token ON",
+                           analyze.command, current_lex.ident_name);
+    }
+    get_lex();
+}
+
+type_of_lex Analyze::Parser::index_type()
+{
+    if (current_lex.ident_type != LEX_USING) {
+        return LEX_HASH; // по умолчанию -- хеш-индекс
+    }
+    get_lex();
+    type_of_lex type = current_lex.ident_type;
+    if (type != LEX_HASH && type != LEX_BTREE) {
+        throw AnalyzeError("SYNTAX ERROR: expected token HASH | BTREE",
+                           analyze.command, current_lex.ident_name);
+    }
+    get_lex();
+    return type;
+}
+
 void Analyze::Parser::TABLE()
 {
     if (current_lex.ident_type != LEX_TABLE) {
         throw AnalyzeError("SYNTAX ERROR: expected token TABLE",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -682,12 +852,12 @@ void Analyze::Parser::new_table_name()
 {
     if (current_lex.ident_type != LEX_ID) {
         throw AnalyzeError("SYNTAX ERROR: expected token ID",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
 #if SEMANTIC
-    if (table_exist(table_access_key, current_lex.ident_name)) {
+    if (table_exist(analyze.table_access_key, current_lex.ident_name)) {
         throw AnalyzeError("SEMANTIC ERROR: table with the given name already exist",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     table_head = current_lex.ident_name;
 #endif
@@ -713,7 +883,7 @@ void Analyze::Parser::new_object_name()
 {
     if (current_lex.ident_type != LEX_ID) {
         throw AnalyzeError("SYNTAX ERROR: expected token ID",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -726,7 +896,7 @@ void Analyze::Parser::object_type()
         get_lex();
     } else {
         throw AnalyzeError("SYNTAX ERROR: expected token TEXT | LONG",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
 }
 
@@ -734,7 +904,7 @@ void Analyze::Parser::unsigned_int()
 {
     if (current_lex.ident_type != LEX_NUM) {
         throw AnalyzeError("SYNTAX ERROR: expected token NUMBER",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -750,6 +920,17 @@ void Analyze::Parser::DROP()
 }
 
 
+/* ---------- COPY ---------- */
+
+void Analyze::Parser::COPY()
+{
+    /* COPY */
+    table_name();
+    FROM();
+    string(); // имя файла CSV на стороне сервера
+}
+
+
 /* --------- WHERE --------- */
 
 void Analyze::Parser::WHERE_clause()
@@ -770,8 +951,8 @@ void Analyze::Parser::WHERE_clause()
         LOGICAL_EXPRESSION
     } where_condition = ERROR;
 
-    for (int k = Analyze::Parser::pos; Analyze::TOKENS[k].ident_type != LEX_FIN; ++k) {
-        type_of_lex lex_type = Analyze::TOKENS[k].ident_type;
+    for (int k = Analyze::Parser::pos; analyze.TOKENS[k].ident_type != LEX_FIN; ++k) {
+        type_of_lex lex_type = analyze.TOKENS[k].ident_type;
 
         if (lex_type == LEX_GREATER ||
             lex_type == LEX_LESS ||
@@ -804,8 +985,8 @@ void Analyze::Parser::WHERE_clause()
             string();
             break;
 
-        case EXPRESSION:
-            expression();
+        case EXPRESSION: {
+            int type = expression();
 
             if (current_lex.ident_type == LEX_NOT) {
                 get_lex();
@@ -813,8 +994,20 @@ void Analyze::Parser::WHERE_clause()
             IN();
 
             open_bracket();
-            is_subquery() ? subquery() : list_of_constant();
+            if (is_subquery()) {
+                subquery();
+            } else {
+                int list_type = list_of_constant();
+#if SEMANTIC
+                // константы другого типа не совпадут ни с одним значением: такой запрос - ошибка
+                if (list_type != type) {
+                    throw AnalyzeError("SEMANTIC ERROR: type mismatch, the IN list does not match the expression",
+                                       analyze.command, "IN");
+                }
+#endif
+            }
             close_bracket();
+        }
             break;
 
         case LOGICAL_EXPRESSION:
@@ -823,7 +1016,7 @@ void Analyze::Parser::WHERE_clause()
 
         case ERROR:
             throw AnalyzeError("SYNTAX ERROR: incorrect WHERE-preposition",
-                               Analyze::command, "WHERE");
+                               analyze.command, "WHERE");
     } // switch ()
 }
 
@@ -831,7 +1024,7 @@ void Analyze::Parser::WHERE()
 {
     if (current_lex.ident_type != LEX_WHERE) {
         throw AnalyzeError("SYNTAX ERROR: expected token WHERE",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -840,7 +1033,7 @@ void Analyze::Parser::LIKE()
 {
     if (current_lex.ident_type != LEX_LIKE) {
         throw AnalyzeError("SYNTAX ERROR: expected token LIKE",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -849,7 +1042,7 @@ void Analyze::Parser::IN()
 {
     if (current_lex.ident_type != LEX_IN) {
         throw AnalyzeError("SYNTAX ERROR: expected token IN",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -863,16 +1056,16 @@ int Analyze::Parser::expression()
         text_expression();
         return TEXT;
     } else if (current_lex.ident_type == LEX_ID) {
-        if (!object_exist(Analyze::table_access_key, table_head, current_lex.ident_name)) {
+        if (!object_exist(analyze.table_access_key, table_head, current_lex.ident_name)) {
             throw AnalyzeError("SEMANTIC ERROR: this field does not exist in the specified table",
-                               Analyze::command, current_lex.ident_name);
+                               analyze.command, current_lex.ident_name);
         }
-        ::object_type lex_type = get_object_type(Analyze::table_access_key, table_head, current_lex.ident_name);
+        ::object_type lex_type = get_object_type(analyze.table_access_key, table_head, current_lex.ident_name);
         lex_type == LONG ? long_expression() : text_expression();
         return lex_type;
     } else {
         throw AnalyzeError("SYNTAX ERROR: expected <long_expression> | <text_expression>",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
 }
 
@@ -916,16 +1109,16 @@ void Analyze::Parser::long_value()
         // LONG_object_name
         if (current_lex.ident_type != LEX_ID) {
             throw AnalyzeError("SYNTAX ERROR: expected token ID",
-                               Analyze::command, current_lex.ident_name);
+                               analyze.command, current_lex.ident_name);
         }
 #if SEMANTIC
-        if (!object_exist(Analyze::table_access_key, table_head, current_lex.ident_name)) {
+        if (!object_exist(analyze.table_access_key, table_head, current_lex.ident_name)) {
             throw AnalyzeError("SEMANTIC ERROR: this field does not exist in the specified table",
-                               Analyze::command, current_lex.ident_name);
+                               analyze.command, current_lex.ident_name);
         }
-        if (get_object_type(Analyze::table_access_key, table_head, current_lex.ident_name) != LONG) {
+        if (get_object_type(analyze.table_access_key, table_head, current_lex.ident_name) != LONG) {
             throw AnalyzeError("SEMANTIC ERROR: type mismatch, LONG type field expected",
-                               Analyze::command, current_lex.ident_name);
+                               analyze.command, current_lex.ident_name);
         }
 #endif
         get_lex();
@@ -940,23 +1133,23 @@ void Analyze::Parser::text_expression()
         // TEXT_object_name
         if (current_lex.ident_type != LEX_ID) {
             throw AnalyzeError("SYNTAX ERROR: expected token ID",
-                               Analyze::command, current_lex.ident_name);
+                               analyze.command, current_lex.ident_name);
         }
 #if SEMANTIC
-        if (!object_exist(Analyze::table_access_key, table_head, current_lex.ident_name)) {
+        if (!object_exist(analyze.table_access_key, table_head, current_lex.ident_name)) {
             throw AnalyzeError("SEMANTIC ERROR: this field does not exist in the specified table",
-                               Analyze::command, current_lex.ident_name);
+                               analyze.command, current_lex.ident_name);
         }
-        if (get_object_type(Analyze::table_access_key, table_head, current_lex.ident_name) != TEXT) {
+        if (get_object_type(analyze.table_access_key, table_head, current_lex.ident_name) != TEXT) {
             throw AnalyzeError("SEMANTIC ERROR: type mismatch, TEXT type field expected",
-                               Analyze::command, current_lex.ident_name);
+                               analyze.command, current_lex.ident_name);
         }
 #endif
         get_lex();
     }
 }
 
-void Analyze::Parser::list_of_constant()
+int Analyze::Parser::list_of_constant()
 {
     if (current_lex.ident_type == LEX_QUOTE) {
         string();
@@ -964,15 +1157,17 @@ void Analyze::Parser::list_of_constant()
             get_lex();
             string();
         }
+        return TEXT;
     } else if (current_lex.ident_type == LEX_NUM) {
         get_lex();
         while (current_lex.ident_type == LEX_COMMA) {
             get_lex();
             unsigned_int(); // long_integer
         }
+        return LONG;
     } else {
         throw AnalyzeError("SYNTAX ERROR: expected token \' | NUMBER",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
 }
 
@@ -1015,11 +1210,11 @@ void Analyze::Parser::relation()
     } else if (current_lex.ident_type == LEX_QUOTE) {
         text_relation();
     } else if (current_lex.ident_type == LEX_ID) {
-        if (!object_exist(Analyze::table_access_key, table_head, current_lex.ident_name)) {
+        if (!object_exist(analyze.table_access_key, table_head, current_lex.ident_name)) {
             throw AnalyzeError("SEMANTIC ERROR: this field does not exist in the specified table",
-                               Analyze::command, current_lex.ident_name);
+                               analyze.command, current_lex.ident_name);
         }
-        ::object_type lex_type = get_object_type(Analyze::table_access_key, table_head, current_lex.ident_name);
+        ::object_type lex_type = get_object_type(analyze.table_access_key, table_head, current_lex.ident_name);
         if (lex_type == LONG) {
             long_relation();
         } else if (lex_type == TEXT) {
@@ -1027,7 +1222,7 @@ void Analyze::Parser::relation()
         }
     } else {
         throw AnalyzeError("SYNTAX ERROR: expected <long_expression> | <text_expression>",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
 }
 
@@ -1054,7 +1249,7 @@ void Analyze::Parser::comparison_operation()
         current_lex.ident_type != LEX_LESS_OR_EQUAL &&
         current_lex.ident_type != LEX_NOT_EQUAL) {
         throw AnalyzeError("SYNTAX ERROR: expected token = | > | < | >= | <= | !=",
-                           Analyze::command, current_lex.ident_name);
+                           analyze.command, current_lex.ident_name);
     }
     get_lex();
 }
@@ -1082,10 +1277,19 @@ void Analyze::Parser::subquery()
 //}
 /* --------------------- class Executor --------------------- */
 
-Analyze::Executor::Executor() = default;
+Analyze::Executor::Executor(Analyze &analyze) : analyze(analyze)
+{}
 
 void Analyze::Executor::interpreter()
 {
+    if (analyze.TOKENS[0].ident_type == LEX_INSERT) {
+        insert_values(); // значения уже проверены анализатором: ПОЛИЗ для вставки не нужен
+        return;
+    }
+    if (analyze.TOKENS[0].ident_type == LEX_COPY) {
+        copy_values();
+        return;
+    }
     to_POLIS();
     try {
         /**
@@ -1094,87 +1298,90 @@ void Analyze::Executor::interpreter()
          *  все входные данные уже корректны после этапа анализа,
          *  т.ч. этот try-блок, суорее всего, даже не понадобится
          */
-        Analyze::table_is_actual = false;
+        analyze.table_is_actual = false;
         Where_condition cur_where = Where_condition();
-        Identifier current_command = Analyze::POLIS.back();
-        Analyze::POLIS.pop_back();
+        Identifier current_command = analyze.POLIS.back();
+        analyze.POLIS.pop_back();
         if(current_command.ident_type == LEX_WHERE){
             fill_where(cur_where);
-            current_command = Analyze::POLIS.back();
-            Analyze::POLIS.pop_back();
+            current_command = analyze.POLIS.back();
+            analyze.POLIS.pop_back();
         }
         switch (current_command.ident_type) {
             case LEX_CREATE: {
+                if (analyze.POLIS[0].ident_type == LEX_INDEX) {
+                    // ПОЛИЗ: INDEX <index_name> <table_name> <object_name> [HASH | BTREE]
+                    create_index(analyze.table_access_key, analyze.POLIS[1].ident_name,
+                                 analyze.POLIS[2].ident_name, analyze.POLIS[3].ident_name,
+                                 analyze.POLIS.size() > 4 ? analyze.POLIS[4].ident_name : "HASH");
+                    analyze.POLIS.clear();
+                    break;
+                }
                 std::string table_name;
                 std::vector<std::pair<std::string, std::string>> arguments;
-                for (int i = Analyze::POLIS.size() - 1; i > 1; i -= 2) {
+                for (int i = analyze.POLIS.size() - 1; i > 1; i -= 2) {
                     // заполняю имена и типы столбцов
-                    arguments.emplace_back(Analyze::POLIS[i - 1].ident_name, Analyze::POLIS[i].ident_name);
-                    Analyze::POLIS.pop_back();
-                    Analyze::POLIS.pop_back();
+                    arguments.emplace_back(analyze.POLIS[i - 1].ident_name, analyze.POLIS[i].ident_name);
+                    analyze.POLIS.pop_back();
+                    analyze.POLIS.pop_back();
                 }
-                table_name = Analyze::POLIS.back().ident_name;
-                Analyze::POLIS.pop_back();
-                create_table(Analyze::table_access_key, table_name, arguments);
+                // столбцы снимались с конца ПОЛИЗа: восстанавливаем порядок объявления
+                std::reverse(arguments.begin(), arguments.end());
+                table_name = analyze.POLIS.back().ident_name;
+                analyze.POLIS.pop_back();
+                create_table(analyze.table_access_key, table_name, arguments);
             }
                 break;
 
             case LEX_SELECT:{
                 // пропускаю FROM
-                Analyze::POLIS.pop_back();
-                std::string table_name = Analyze::POLIS.back().ident_name;
-                Analyze::POLIS.pop_back();
+                analyze.POLIS.pop_back();
+                std::string table_name = analyze.POLIS.back().ident_name;
+                analyze.POLIS.pop_back();
                 std::vector<std::string> column_names;
-                while (!Analyze::POLIS.empty()) {
-                    column_names.push_back(Analyze::POLIS.back().ident_name);
-                    Analyze::POLIS.pop_back();
+                while (!analyze.POLIS.empty()) {
+                    column_names.push_back(analyze.POLIS.back().ident_name);
+                    analyze.POLIS.pop_back();
                 }
+                std::reverse(column_names.begin(), column_names.end());
 
-                select_from_table(Analyze::table_access_key,
+                select_from_table(analyze.table_access_key,
                         table_name,
                         column_names,
                         cur_where,
-                        Analyze::selected_table);
-                table_is_actual = true;
-            }
-                break;
-            case LEX_INSERT:{
-                std::vector<std::string> new_record;
-                while (!Analyze::POLIS.empty()){
-                    // заполняю поля столбцов
-                    new_record.push_back(Analyze::POLIS.back().ident_name);
-                    Analyze::POLIS.pop_back();
-                }
-                // заполняю имя таблицы
-                std::string table_name = new_record.back();
-                new_record.pop_back();
-                insert_into_table(Analyze::table_access_key, table_name, new_record);
+                        analyze.selected_table);
+                analyze.table_is_actual = true;
             }
                 break;
             case LEX_UPDATE:{
                 // пропускаю (SET, LEX_SET);
-                Analyze::POLIS.pop_back();
+                analyze.POLIS.pop_back();
                 // пропускаю (=, LEX_EQUAL);
-                Analyze::POLIS.pop_back();
-
-                std::string value = Analyze::POLIS.back().ident_name;
-                Analyze::POLIS.pop_back();
-                std::string col_name = Analyze::POLIS.back().ident_name;
-                Analyze::POLIS.pop_back();
-                std::string table_name = Analyze::POLIS.back().ident_name;
-                Analyze::POLIS.pop_back();
-                update_table(Analyze::table_access_key, table_name, col_name, value, cur_where);
+                analyze.POLIS.pop_back();
+
+                // ПОЛИЗ: <table_name> <object_name> <expression>
+                std::string table_name = analyze.POLIS[0].ident_name;
+                std::string col_name = analyze.POLIS[1].ident_name;
+                Expression value;
+                for (int i = 2; i < analyze.POLIS.size(); ++i) {
+                    value.push(to_operation(analyze.POLIS[i]), analyze.POLIS[i].ident_name);
+                }
+                analyze.POLIS.clear();
+                update_table(analyze.table_access_key, table_name, col_name, value, cur_where);
             }
                 break;
             case LEX_DELETE:{
-                std::string table_name = Analyze::POLIS.back().ident_name;
-                Analyze::POLIS.pop_back();
-                delete_table(Analyze::table_access_key, table_name, cur_where);
+                std::string table_name = analyze.POLIS.back().ident_name;
+                analyze.POLIS.pop_back();
+                delete_table(analyze.table_access_key, table_name, cur_where);
             }
                 break;
+            case LEX_CHECKPOINT:
+                checkpoint_database(analyze.table_access_key, analyze.TOKENS[1].ident_type == LEX_BACKGROUND);
+                break;
             case LEX_DROP: {
-                std::string table_name = Analyze::POLIS.back().ident_name;
-                drop_table(Analyze::table_access_key, table_name);
+                std::string table_name = analyze.POLIS.back().ident_name;
+                drop_table(analyze.table_access_key, table_name);
             }
                 break;
         }
@@ -1182,44 +1389,160 @@ void Analyze::Executor::interpreter()
     }
     catch (std::exception &err) {
         throw AnalyzeError(std::string("RUN TIME ERROR: ") + err.what(),
-                           Analyze::command, ";");
+                           analyze.command, ";");
+    }
+}
+
+void Analyze::Executor::insert_values()
+{
+    // INSERT INTO <table_name> [VALUES] (<value>, ...), ...: значения -- все числа и строки по порядку
+    std::vector<std::string> new_records;
+    new_records.reserve(analyze.TOKENS.size() / 2);
+    for (size_t i = 3; analyze.TOKENS[i].ident_type != LEX_FIN; ++i) {
+        if (analyze.TOKENS[i].ident_type == LEX_NUM || analyze.TOKENS[i].ident_type == LEX_STRING) {
+            new_records.push_back(std::move(analyze.TOKENS[i].ident_name));
+        }
+    }
+    try {
+        insert_into_table(analyze.table_access_key, analyze.TOKENS[2].ident_name, new_records);
+    }
+    catch (std::exception &err) {
+        throw AnalyzeError(std::string("RUN TIME ERROR: ") + err.what(),
+                           analyze.command, ";");
+    }
+}
+
+void Analyze::Executor::copy_values()
+{
+    // COPY <table_name> FROM ' <file_name> '
+    try {
+        const std::string &table_name = analyze.TOKENS[1].ident_name;
+        // файл ищется только в каталоге импорта; каждая часть читается от начала к концу
+        Mapped_file file(import_path(analyze.TOKENS[4].ident_name), true);
+        copy_into_table(analyze.table_access_key, table_name, file.data());
+        // в журнал попадают сами строки (большой файл -- копией рядом с журналом):
+        // при повторе файл может уже быть другим или отсутствовать
+        analyze.commit_lsn = wal.append("COPY " + table_name + COPY_DATA, file.data());
+    }
+    catch (std::exception &err) {
+        throw AnalyzeError(std::string("RUN TIME ERROR: ") + err.what(),
+                           analyze.command, ";");
     }
 }
 
 void Analyze::Executor::fill_where(Where_condition & where){
-    Identifier current_command = Analyze::POLIS.back();
-    Analyze::POLIS.pop_back();
-    if (current_command.ident_type == LEX_ALL){
+    /**
+     * where-часть ПОЛИЗа расположена между командой (SELECT | UPDATE | DELETE)
+     * и уже снятой лексемой WHERE
+     */
+    int begin = analyze.POLIS.size(), commands = 0;
+    for (const auto &lex : analyze.POLIS) {
+        if (lex.ident_type == LEX_SELECT || lex.ident_type == LEX_INSERT || lex.ident_type == LEX_UPDATE ||
+            lex.ident_type == LEX_DELETE || lex.ident_type == LEX_CREATE || lex.ident_type == LEX_DROP) {
+            ++commands;
+        }
+    }
+    if (commands > 1) {
+        throw std::runtime_error("subqueries are not supported");
+    }
+    while (begin > 0 &&
+           analyze.POLIS[begin - 1].ident_type != LEX_SELECT &&
+           analyze.POLIS[begin - 1].ident_type != LEX_UPDATE &&
+           analyze.POLIS[begin - 1].ident_type != LEX_DELETE) {
+        --begin;
+    }
+    std::vector<Identifier> items(analyze.POLIS.begin() + begin, analyze.POLIS.end());
+    analyze.POLIS.erase(analyze.POLIS.begin() + begin, analyze.POLIS.end());
+
+    if (items.size() == 1 && items[0].ident_type == LEX_ALL) {
         return;
     }
-    std::cout<<"я это еще не сделал!\n";
+
+    type_of_lex where_type = items.back().ident_type;
+    if (where_type == LEX_LIKE || where_type == LEX_IN) {
+        items.pop_back();
+        // NOT в [NOT] LIKE и [NOT] IN относится ко всему условию
+        auto not_it = std::find_if(items.begin(), items.end(),
+                                   [](const Identifier &lex) { return lex.ident_type == LEX_NOT; });
+        if (not_it != items.end()) {
+            where.set_not();
+            items.erase(not_it);
+        }
+
+        if (where_type == LEX_LIKE) {
+            where.set_pattern(items.back().ident_name);
+            items.pop_back();
+        } else {
+            // левая часть IN оставляет на стеке одно значение, остальные -- список констант
+            int depth = 0;
+            for (const auto &lex : items) {
+                depth += (lex.ident_type == LEX_ID || lex.ident_type == LEX_NUM || lex.ident_type == LEX_STRING) ? 1 : -1;
+            }
+            for (; depth > 1; --depth) {
+                where.set_set(items.back().ident_name);
+                items.pop_back();
+            }
+        }
+    }
+
+    for (const auto &lex : items) {
+        where.set_logical_exp(to_operation(lex), lex.ident_name);
+    }
+}
+
+operation_type Analyze::Executor::to_operation(const Identifier &lex)
+{
+    switch (lex.ident_type) {
+        case LEX_ID:               return OP_COLUMN;
+        case LEX_NUM:              return OP_NUMBER;
+        case LEX_STRING:           return OP_STRING;
+        case LEX_PLUS:             return OP_PLUS;
+        case LEX_MINUS:            return OP_MINUS;
+        case LEX_STAR:             return OP_MULTIPLY;
+        case LEX_SLASH:            return OP_DIVIDE;
+        case LEX_PERCENT:          return OP_MODULO;
+        case LEX_EQUAL:            return OP_EQUAL;
+        case LEX_NOT_EQUAL:        return OP_NOT_EQUAL;
+        case LEX_LESS:             return OP_LESS;
+        case LEX_GREATER:          return OP_GREATER;
+        case LEX_LESS_OR_EQUAL:    return OP_LESS_OR_EQUAL;
+        case LEX_GREATER_OR_EQUAL: return OP_GREATER_OR_EQUAL;
+        case LEX_AND:              return OP_AND;
+        case LEX_OR:               return OP_OR;
+        case LEX_NOT:              return OP_NOT;
+        default:
+            throw std::runtime_error("unexpected lexeme \'" + lex.ident_name + "\' in expression");
+    }
 }
 
 void Analyze::Executor::to_POLIS()
 {
     std::stack<Identifier> stack_of_operations;
 
-    for (int cur_pos = 0; Analyze::TOKENS[cur_pos].ident_type != LEX_FIN; ++cur_pos) {
-        switch (Analyze::TOKENS[cur_pos].ident_type) {
+    for (int cur_pos = 0; analyze.TOKENS[cur_pos].ident_type != LEX_FIN; ++cur_pos) {
+        switch (analyze.TOKENS[cur_pos].ident_type) {
             case LEX_ID:
             case LEX_NUM:
             case LEX_ALL:
             case LEX_TEXT:
             case LEX_LONG:
             case LEX_STRING:
+            case LEX_INDEX:
+            case LEX_HASH:
+            case LEX_BTREE:
                 // операнды
-                Analyze::POLIS.push_back(Analyze::TOKENS[cur_pos]);
+                analyze.POLIS.push_back(analyze.TOKENS[cur_pos]);
                 break;
 
             case LEX_OPEN_BRACKET:
                 // открывающая скобка
-                stack_of_operations.push(Analyze::TOKENS[cur_pos]);
+                stack_of_operations.push(analyze.TOKENS[cur_pos]);
                 break;
 
             case LEX_CLOSE_BRACKET:
                 // закрывающая скобка
                 while (stack_of_operations.top().ident_type != LEX_OPEN_BRACKET) {
-                    Analyze::POLIS.push_back(stack_of_operations.top());
+                    analyze.POLIS.push_back(stack_of_operations.top());
                     stack_of_operations.pop();
                 }
                 stack_of_operations.pop(); // выкинули открывающую скобку
@@ -1227,22 +1550,31 @@ void Analyze::Executor::to_POLIS()
 
             case LEX_QUOTE:
             case LEX_INTO:
+            case LEX_VALUES:
             case LEX_TABLE:
+            case LEX_ON:
+            case LEX_USING:
+            case LEX_BACKGROUND:
             case LEX_COMMA:
                 // в ПОЛИЗ не переводим
                 break;
 
+            case LEX_NOT:
+                // префиксная операция: ничего не выталкивает из стека
+                stack_of_operations.push(analyze.TOKENS[cur_pos]);
+                break;
+
             default:
                 // операция
                 while (!stack_of_operations.empty() &&
-                       priority(Analyze::TOKENS[cur_pos].ident_type) <=
+                       priority(analyze.TOKENS[cur_pos].ident_type) <=
                        priority(stack_of_operations.top().ident_type)) {
-                    Analyze::POLIS.push_back(stack_of_operations.top());
+                    analyze.POLIS.push_back(stack_of_operations.top());
                     stack_of_operations.pop();
                 }
-                stack_of_operations.push(Analyze::TOKENS[cur_pos]);
+                stack_of_operations.push(analyze.TOKENS[cur_pos]);
 
-                if (Analyze::TOKENS[cur_pos].ident_type == LEX_DELETE) {
+                if (analyze.TOKENS[cur_pos].ident_type == LEX_DELETE) {
                     cur_pos++; // пропуск FROM после DELETE
                     // отдельно, т.к. FROM является операцией в SELECT-предложении
                 }
@@ -1251,11 +1583,11 @@ void Analyze::Executor::to_POLIS()
     }
 
     while (!stack_of_operations.empty()) { // освобождаем стек
-        Analyze::POLIS.push_back(stack_of_operations.top());
+        analyze.POLIS.push_back(stack_of_operations.top());
         stack_of_operations.pop();
     }
 #if DEBUG
-    Analyze::Scanner::print_TABLE(Analyze::POLIS, "POLIS");
+    Analyze::Scanner::print_TABLE(analyze.POLIS, "POLIS");
 #endif
 }
 
@@ -1275,6 +1607,7 @@ int Analyze::Executor::priority(type_of_lex operation)
         case LEX_DELETE:
         case LEX_CREATE:
         case LEX_DROP: 
+        case LEX_CHECKPOINT:
             return 2;
 
         case LEX_FROM:
@@ -1289,26 +1622,26 @@ int Analyze::Executor::priority(type_of_lex operation)
         case LEX_AND:
             return 5;
 
+        case LEX_NOT: // NOT относится ко всему отношению: NOT a > b == NOT (a > b)
+            return 6;
+
         case LEX_EQUAL:
         case LEX_NOT_EQUAL:
-            return 6;
+            return 7;
 
         case LEX_LESS:
         case LEX_GREATER:
         case LEX_LESS_OR_EQUAL:
         case LEX_GREATER_OR_EQUAL:
-            return 7;
+            return 8;
 
         case LEX_PLUS:
         case LEX_MINUS:
-            return 8;
+            return 9;
 
         case LEX_STAR:
         case LEX_SLASH:
         case LEX_PERCENT:
-            return 9;
-
-        case LEX_NOT:
             return 10;
 
         default:
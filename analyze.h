@@ -6,7 +6,9 @@
 #include <string>   // std::string
 #include <vector>   // std::vector
 #include <set>      // std::set
+#include <cstdint>  // uint64_t
 #include "table.h"
+#include "Where_condition.h"
 
 /* ------------------------------------------------ */
 /* ------------------- ANALYZE -------------------- */
@@ -38,6 +40,15 @@ enum type_of_lex
     LEX_AND,
     LEX_OR,
     LEX_ALL,
+    LEX_INDEX,
+    LEX_ON,
+    LEX_USING,
+    LEX_HASH,
+    LEX_BTREE,
+    LEX_VALUES,
+    LEX_COPY,
+    LEX_CHECKPOINT,
+    LEX_BACKGROUND,
     /* служебные символы */
     LEX_FIN, 
     LEX_COMMA,
@@ -96,40 +107,79 @@ public:
 class Analyze
 {
 public:
+    /**
+     * [constructor: creates an analyzer session working with the tables of <key>]
+     * [             (one session per client; commands are passed to start())   ]
+     */
+    explicit Analyze(int key);
+
     /**
      * [constructor: creates an analyzer object for the <query>]
      */
     Analyze(int key, const std::string &query);
 
     /**
-     * [destructor: clears the memory from under static objects]
+     * [start: run command analysis]
+     */
+    void start();
+
+    /**
+     * [start: run analysis of the next command <query> of the session]
      */
-    ~Analyze();
+    void start(const std::string &query);
 
     /**
-     * [start: run command analysis]
+     * [release: releases the table locked by the last command; call after reading its result]
+     * [         (otherwise the lock is released by the next command or by the destructor)    ]
      */
-    static void start();
+    void release();
+
+    /**
+     * [replay: repeats the log <record> of a command (see wal.h); the data of a COPY follows its]
+     * [        command in the <record> or, if the log kept it in a file, is the <data>         ]
+     */
+    void replay(std::string_view record, std::string_view data = std::string_view());
 
 
     /**
     * [get_table_text: return table in string representation]
     */
     std::string get_table_text();
-    static bool table_is_actual; // обновленная или мусорная таблица сейчас находится в selected_table
+
+    /**
+    * [get_table_view: return the view selected by the last command (nullptr if it selected nothing);]
+    * [                it stays valid until release() or the next command                            ]
+    */
+    const Table_view *get_table_view() const;
+
+    /**
+    * [get_commit_lsn: return the log record of the last command (0 if it changed nothing);]
+    * [                its answer may be sent only after wal.wait() for this record        ]
+    */
+    uint64_t get_commit_lsn() const;
+    bool table_is_actual = false; // обновленная или мусорная таблица сейчас находится в selected_table
     
-    static int table_access_key;             // ключ доступа к таблицам -- дескриптор клиента
-    static std::string command;              // команда для анализа
+    int table_access_key;             // ключ доступа к таблицам -- дескриптор клиента
+    std::string command;              // команда для анализа
 
     static const char * TABLE_OF_LEXEME[];   // таблица лексем по type_of_lex
     static const char * TABLE_OF_KEYWORDS[]; // таблица служебных слов
     static const char * TABLE_OF_DELIMS[];   // таблица служебных символов
-    static std::vector<Identifier> TID;      // таблица идентификаторов
-    static std::vector<Identifier> TOKENS;   // таблица токенов: запрос, разбитый на лексемы
-    static std::vector<Identifier> POLIS;    // таблица внутреннего представления запроса (ПОЛИЗ)
-    static Table selected_table;             // таблица, сгенерированная запросом или подзапросом
-                                             // (если обращение подразумеват генерацию таблицы)
+    std::vector<Identifier> TID;      // таблица идентификаторов
+    std::vector<Identifier> TOKENS;   // таблица токенов: запрос, разбитый на лексемы
+    std::vector<Identifier> POLIS;    // таблица внутреннего представления запроса (ПОЛИЗ)
+    Table_view selected_table;        // представление, сгенерированное запросом или подзапросом
+                                      // (если обращение подразумеват генерацию таблицы)
 private:
+    static const std::string COPY_DATA; // в записи журнала COPY за именем таблицы следуют строки файла
+
+    Table_lock statement_lock;        // блокировки таблицы текущей команды
+    uint64_t commit_lsn = 0;          // запись журнала последней команды
+
+    /**
+     * [lock_tables: locks the table of the command in <TOKENS> for reading or writing]
+     */
+    void lock_tables();
 
     /* --------------------- class Scanner --------------------- */
 
@@ -137,9 +187,9 @@ private:
     {
     public:
         /**
-         * [constructor: creates the object of type <Scanner> out of the <Analyze::command>]
+         * [constructor: creates the object of type <Scanner> out of the <analyze.command>]
          */
-        Scanner();
+        explicit Scanner(Analyze &analyze);
 
         /**
          * [lexical_analyze: provides lexical analysis, puts Identifiers into <Analyze::TOKENS>]
@@ -152,8 +202,11 @@ private:
         static void print_TABLE(std::vector<Identifier> TABLE, const char *table_name = "TABLE");
 
     private:
+        Analyze &analyze;       // сеанс, команду которого разбираем
         char c;                 // текущий считываемый из команды символ
-        std::istringstream sin; // поток ввода, сформированный из команды Analyze::command
+        std::istringstream sin; // поток ввода, сформированный из команды analyze.command
+        bool is_first_quote = false;  // следующая кавычка -- открывающая
+        bool is_second_quote = false; // следующая кавычка -- закрывающая
 
         /**
          * [get_char: reads a symbol from <Scanner::sin>]
@@ -173,7 +226,7 @@ private:
         /**
          * [put_to_TID: puts Users' Identifiers to <Analyze::TID>]
          */
-        static int put_to_TID(const std::string &lex);
+        int put_to_TID(const std::string &lex);
     }; // class Scanner
 
 
@@ -182,9 +235,9 @@ private:
     class Parser {
     public:
         /**
-         * [constructor: default]
+         * [constructor: creates a parser of the tokens of <analyze>]
          */
-        Parser();
+        explicit Parser(Analyze &analyze);
 
         /**
          * [syntactic_analyze: provides syntactic analysis]
@@ -192,6 +245,8 @@ private:
         void syntactic_analyze();
 
     private:
+        Analyze &analyze; // сеанс, команду которого разбираем
+
         /* for syntactic analysis: */
         Identifier current_lex; // текущий анализируемый идентификатор
         int pos = 0;            // позиция <current_lex> в <Analyze::TOKENS>
@@ -227,6 +282,9 @@ private:
                 void EQUAL();
             void DELETE();
             void CREATE();
+                void new_index_name();
+                void ON();
+                type_of_lex index_type();
                 void TABLE();
                 void new_table_name();
                 void list_of_object_expression();
@@ -235,6 +293,7 @@ private:
                         void object_type();
                             void unsigned_int();
             void DROP();
+            void COPY();
 
         void WHERE_clause();
             void WHERE();
@@ -246,7 +305,7 @@ private:
                         void long_multiplier();
                             void long_value();
                 void text_expression();
-                void list_of_constant();
+                int list_of_constant(); // тип констант списка: LONG или TEXT
 
             void logical_expression();
                 void logical_term();
@@ -266,9 +325,9 @@ private:
     {
     public:
         /**
-         * [constructor: default]
+         * [constructor: creates an executor of the command of <analyze>]
          */
-        Executor();
+        explicit Executor(Analyze &analyze);
 
         /**
          * [interpreter: executes user request by <Analyze::POLIS>]
@@ -276,16 +335,34 @@ private:
         void interpreter();
 
     private:
+        Analyze &analyze; // сеанс, команду которого исполняем
+
         /**
          * [to_POLIS: translate the request from <Analyze::TOKENS> to the <Analyze::POLIS>]
          */
-        static void to_POLIS();
+        void to_POLIS();
+
+        /**
+         * [insert_values: executes INSERT straight from <Analyze::TOKENS>, bypassing the POLIS]
+         */
+        void insert_values();
+
+        /**
+         * [copy_values: executes COPY <table_name> FROM '<file_name>' straight from <Analyze::TOKENS>]
+         * [             and logs the records of the file along with it                            ]
+         */
+        void copy_values();
 
         /**
          * [fill_where: fill class where_condition]
          */
         void fill_where(Where_condition & where);
 
+        /**
+         * [to_operation: returns the expression element corresponding to the <lex>]
+         */
+        static operation_type to_operation(const Identifier &lex);
+
         /**
          * [priority: give priority to <operation>]
          */
@@ -0,0 +1,85 @@
+#include <cstddef>     // size_t
+#include <cstring>     // memcpy()
+#include <string_view> // std::string_view
+#include <memory>      // std::unique_ptr, std::shared_ptr
+#include <utility>     // std::move(), std::exchange()
+#include <algorithm>   // std::min()
+
+#include "arena.h" // прототипы всех функций, описанных в этом файле
+
+
+/* -------------------- class String_arena -------------------- */
+
+String_arena::String_arena(String_arena &&other) noexcept
+        : chunks(std::move(other.chunks)), files(std::move(other.files)),
+          free_begin(std::exchange(other.free_begin, nullptr)), free_size(std::exchange(other.free_size, 0)),
+          chunk_size(std::exchange(other.chunk_size, 0)), total_size(std::exchange(other.total_size, 0)),
+          garbage_size(std::exchange(other.garbage_size, 0))
+{
+    other.chunks.clear();
+    other.files.clear();
+}
+
+
+String_arena &String_arena::operator=(String_arena &&other) noexcept
+{
+    if (this != &other) {
+        // свободное место <other> должно уйти вместе с его кусками, а не остаться в нём
+        chunks = std::move(other.chunks);
+        files = std::move(other.files);
+        other.chunks.clear();
+        other.files.clear();
+        free_begin = std::exchange(other.free_begin, nullptr);
+        free_size = std::exchange(other.free_size, 0);
+        chunk_size = std::exchange(other.chunk_size, 0);
+        total_size = std::exchange(other.total_size, 0);
+        garbage_size = std::exchange(other.garbage_size, 0);
+    }
+    return *this;
+}
+
+
+std::string_view String_arena::store(std::string_view value)
+{
+    if (value.empty()) {
+        return std::string_view();
+    }
+    if (value.size() > free_size) {
+        if (value.size() > CHUNK_LIMIT / 4) {
+            // длинная строка получает свой кусок, свободное место текущего куска не теряется
+            chunks.emplace_back(new char[value.size()]);
+            memcpy(chunks.back().get(), value.data(), value.size());
+            total_size += value.size();
+            return std::string_view(chunks.back().get(), value.size());
+        }
+        chunk_size = chunk_size == 0 ? FIRST_CHUNK : std::min(2 * chunk_size, CHUNK_LIMIT);
+        chunks.emplace_back(new char[chunk_size]);
+        free_begin = chunks.back().get();
+        free_size = chunk_size;
+    }
+    char *copy = free_begin;
+    memcpy(copy, value.data(), value.size());
+    free_begin += value.size();
+    free_size -= value.size();
+    total_size += value.size();
+    return std::string_view(copy, value.size());
+}
+
+
+void String_arena::adopt(std::shared_ptr<const Mapped_file> file, size_t size)
+{
+    files.push_back(std::move(file));
+    total_size += size;
+}
+
+
+void String_arena::clear()
+{
+    chunks.clear();
+    files.clear();
+    free_begin = nullptr;
+    free_size = 0;
+    chunk_size = 0;
+    total_size = 0;
+    garbage_size = 0;
+}
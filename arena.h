@@ -0,0 +1,82 @@
+#ifndef SQL_INTERPRETER_ARENA_H
+#define SQL_INTERPRETER_ARENA_H
+
+#include <cstddef>     // size_t
+#include <string_view> // std::string_view
+#include <vector>      // std::vector
+#include <memory>      // std::unique_ptr, std::shared_ptr
+#include "mapped.h"    // Mapped_file
+
+/* ------------------------------------------------ */
+/* --------------------- ARENA -------------------- */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] байты строк поля TEXT: строки копируются подряд в большие куски памяти, которые
+ *       никогда не перемещаются (ссылки std::string_view на строки остаются верными до clear()),
+ *       и освобождаются только все разом; строки таблицы, прочитанной из файла, остаются
+ *       в отображённом файле, арена лишь держит его открытым;
+ *       изменённая строка не освобождается, а учитывается в garbage(): когда мусора становится
+ *       много, владелец переписывает живые строки в новую арену
+ */
+class String_arena
+{
+public:
+    static constexpr size_t FIRST_CHUNK = 4096; // первый кусок (в маленьких таблицах память не пропадает)
+    static constexpr size_t CHUNK_LIMIT = 1 << 20; // дальше куски растут вдвое до этого размера
+
+    String_arena() = default;
+
+    String_arena(const String_arena &) = delete;
+    String_arena &operator=(const String_arena &) = delete;
+
+    String_arena(String_arena &&other) noexcept;
+    String_arena &operator=(String_arena &&other) noexcept;
+
+    /**
+     * [store: copies <value> into the arena and returns the copy]
+     */
+    std::string_view store(std::string_view value);
+
+    /**
+     * [adopt: keeps the mapped <file> open: <size> bytes of strings are used right in it]
+     */
+    void adopt(std::shared_ptr<const Mapped_file> file, size_t size);
+
+    /**
+     * [forget: notes that the stored <value> is no longer used]
+     */
+    void forget(std::string_view value)
+    {
+        garbage_size += value.size();
+    }
+
+    /**
+     * [size/garbage: return the number of bytes held by the arena / no longer used in it]
+     */
+    size_t size() const
+    {
+        return total_size;
+    }
+
+    size_t garbage() const
+    {
+        return garbage_size;
+    }
+
+    /**
+     * [clear: frees all the strings at once]
+     */
+    void clear();
+
+private:
+    std::vector<std::unique_ptr<char[]>> chunks;             // куски памяти со строками
+    std::vector<std::shared_ptr<const Mapped_file>> files;   // файлы, в которых лежат строки
+    char *free_begin = nullptr; // начало свободного места в текущем куске
+    size_t free_size = 0;       // сколько в нём ещё свободно
+    size_t chunk_size = 0;      // размер текущего куска
+    size_t total_size = 0;
+    size_t garbage_size = 0;
+}; // class String_arena
+
+#endif // SQL_INTERPRETER_ARENA_H
@@ -0,0 +1,431 @@
+#include <cstdint>   // int64_t, uint64_t, INT64_MIN, INT64_MAX, UINT64_MAX
+#include <cstddef>   // size_t
+#include <vector>    // std::vector
+#include <utility>   // std::move()
+#include <algorithm> // std::min(), std::max()
+
+#include "compression.h" // прототипы всех функций, описанных в этом файле
+
+
+/**
+ * [bits_for: returns how many bits the unsigned <value> takes]
+ */
+static unsigned bits_for(uint64_t value)
+{
+    return value == 0 ? 0 : 64 - __builtin_clzll(value);
+}
+
+/**
+ * [words_for: returns how many 64-bit words <count> values of <bits> bits take]
+ */
+static size_t words_for(size_t count, unsigned bits)
+{
+    return (count * bits + 63) / 64;
+}
+
+/**
+ * [unpack: returns the value <i> of <bits> bits packed into <words>]
+ */
+static inline uint64_t unpack(const uint64_t *words, size_t i, unsigned bits)
+{
+    if (bits == 0) {
+        return 0;
+    }
+    const size_t position = i * bits, word = position / 64, shift = position % 64;
+    uint64_t value = words[word] >> shift;
+    if (shift + bits > 64) { // значение лежит на границе двух слов
+        value |= words[word + 1] << (64 - shift);
+    }
+    return bits == 64 ? value : value & ((uint64_t(1) << bits) - 1);
+}
+
+/**
+ * [pack: writes the <value> of <bits> bits into the position <i> of the zeroed <words>]
+ */
+static void pack(std::vector<uint64_t> &words, size_t i, unsigned bits, uint64_t value)
+{
+    if (bits == 0) {
+        return;
+    }
+    const size_t position = i * bits, word = position / 64, shift = position % 64;
+    words[word] |= value << shift;
+    if (shift + bits > 64) {
+        words[word + 1] |= value >> (64 - shift);
+    }
+}
+
+/**
+ * [find_run: returns the run of the RLE <words> (<runs> pairs) holding the position <i>]
+ */
+static size_t find_run(const uint64_t *words, size_t runs, size_t i)
+{
+    size_t low = 0, high = runs - 1; // ищем первую серию, которая кончается после <i>
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (words[2 * middle + 1] <= i) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * [for_blocks: splits the <rows> into runs of rows of one block and calls]
+ * [            <f>(block, first row of the block, begin, end) for each    ]
+ */
+template <class Function>
+static void for_blocks(const std::vector<Compressed_longs::Block> &blocks, const size_t *rows, size_t count,
+                       Function f)
+{
+    size_t begin = 0;
+    while (begin < count) {
+        const size_t offset = rows[begin] / Compressed_longs::BLOCK_SIZE * Compressed_longs::BLOCK_SIZE;
+        size_t end = begin + 1;
+        while (end < count && rows[end] >= offset && rows[end] - offset < Compressed_longs::BLOCK_SIZE) {
+            ++end;
+        }
+        f(blocks[offset / Compressed_longs::BLOCK_SIZE], offset, begin, end);
+        begin = end;
+    }
+}
+
+
+/* -------------------- class Block -------------------- */
+
+int64_t Compressed_longs::Block::get(size_t i) const
+{
+    // арифметика без знака: переполнение промежуточных сумм не портит итоговое значение
+    switch (kind) {
+        case PACKED:
+            return static_cast<int64_t>(uint64_t(base) + unpack(words.data(), i, bits));
+        case DELTA:
+            return static_cast<int64_t>(uint64_t(base) + uint64_t(step) * i + unpack(words.data(), i, bits));
+        case RLE:
+            return static_cast<int64_t>(words[2 * find_run(words.data(), words.size() / 2, i)]);
+        default:
+            return static_cast<int64_t>(words[i]);
+    }
+}
+
+
+bool Compressed_longs::Block::consistent() const
+{
+    if (count > BLOCK_SIZE || bits > 64) {
+        return false;
+    }
+    switch (kind) {
+        case PLAIN:
+            return words.size() == count;
+        case PACKED:
+        case DELTA:
+            return words.size() == words_for(count, bits);
+        case RLE: {
+            // концы серий возрастают, последняя кончается концом блока
+            if (words.size() % 2 != 0 || (count != 0 && words.empty())) {
+                return false;
+            }
+            uint64_t end = 0;
+            for (size_t run = 0; run < words.size() / 2; ++run) {
+                if (words[2 * run + 1] <= end) {
+                    return false;
+                }
+                end = words[2 * run + 1];
+            }
+            return end == count;
+        }
+        default:
+            return false;
+    }
+}
+
+
+/* -------------------- class Compressed_longs -------------------- */
+
+void Compressed_longs::set(size_t row, int64_t value)
+{
+    Block &block = blocks[row / BLOCK_SIZE];
+    if (block.get(row % BLOCK_SIZE) == value) {
+        return; // значение не меняется: сжатый блок не распаковываем
+    }
+    unseal(block);
+    block.words.set(row % BLOCK_SIZE, static_cast<uint64_t>(value));
+}
+
+
+void Compressed_longs::push_back(int64_t value)
+{
+    if (blocks.empty() || blocks.back().count == BLOCK_SIZE) {
+        blocks.emplace_back();
+    }
+    Block &block = blocks.back();
+    unseal(block); // неполный блок мог быть сжат при записи в файл
+    block.words.push_back(static_cast<uint64_t>(value));
+    ++block.count;
+    ++records;
+    if (block.count == BLOCK_SIZE) {
+        seal(block);
+    }
+}
+
+
+void Compressed_longs::reserve(size_t capacity)
+{
+    blocks.reserve((capacity + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    if (blocks.empty() || blocks.back().count == BLOCK_SIZE || blocks.back().kind != PLAIN) {
+        return;
+    }
+    // место заранее нужно только последнему блоку; растёт он не меньше чем вдвое
+    Mapped_vector<uint64_t> &words = blocks.back().words;
+    const size_t needed = std::min(BLOCK_SIZE, words.size() + (capacity - records));
+    if (words.capacity() < needed) {
+        words.reserve(std::min(BLOCK_SIZE, std::max(needed, 2 * words.capacity())));
+    }
+}
+
+
+void Compressed_longs::clear()
+{
+    blocks.clear();
+    records = 0;
+}
+
+
+void Compressed_longs::compress()
+{
+    for (auto &block : blocks) {
+        if (!block.sealed && block.count == BLOCK_SIZE) {
+            seal(block);
+        }
+    }
+}
+
+
+void Compressed_longs::gather(const size_t *rows, size_t count, int64_t *out) const
+{
+    for_blocks(blocks, rows, count, [rows, out](const Block &block, size_t offset, size_t begin, size_t end) {
+        const uint64_t *words = block.words.data();
+        switch (block.kind) {
+            case PLAIN:
+                for (size_t i = begin; i < end; ++i) {
+                    out[i] = static_cast<int64_t>(words[rows[i] - offset]);
+                }
+                break;
+            case PACKED:
+                for (size_t i = begin; i < end; ++i) {
+                    out[i] = static_cast<int64_t>(uint64_t(block.base) + unpack(words, rows[i] - offset, block.bits));
+                }
+                break;
+            case DELTA:
+                for (size_t i = begin; i < end; ++i) {
+                    const size_t position = rows[i] - offset;
+                    out[i] = static_cast<int64_t>(uint64_t(block.base) + uint64_t(block.step) * position +
+                                                  unpack(words, position, block.bits));
+                }
+                break;
+            case RLE: {
+                // строки идут по возрастанию: серия ищется двоичным поиском только при откате назад
+                const size_t runs = block.words.size() / 2;
+                size_t run = 0, previous = 0;
+                for (size_t i = begin; i < end; ++i) {
+                    const size_t position = rows[i] - offset;
+                    if (position < previous) {
+                        run = find_run(words, runs, position);
+                    }
+                    while (words[2 * run + 1] <= position) {
+                        ++run;
+                    }
+                    out[i] = static_cast<int64_t>(words[2 * run]);
+                    previous = position;
+                }
+            }
+                break;
+        }
+    });
+}
+
+
+void Compressed_longs::select(const size_t *rows, size_t count, int64_t low, int64_t high, bool inside,
+                              int64_t *out) const
+{
+    for_blocks(blocks, rows, count, [&](const Block &block, size_t offset, size_t begin, size_t end) {
+        const uint64_t *words = block.words.data();
+        switch (block.kind) {
+            case PACKED: {
+                // границы переводятся в разности с минимумом блока: сравниваются упакованные числа
+                const uint64_t max_code = block.bits == 64 ? UINT64_MAX : (uint64_t(1) << block.bits) - 1;
+                const __int128 from = std::max<__int128>(__int128(low) - block.base, 0);
+                const __int128 to = std::min<__int128>(__int128(high) - block.base, max_code);
+                if (from > to) { // в блоке нет ни одного подходящего значения
+                    for (size_t i = begin; i < end; ++i) {
+                        out[i] = !inside;
+                    }
+                    break;
+                }
+                const uint64_t first = static_cast<uint64_t>(from), width = static_cast<uint64_t>(to - from);
+                for (size_t i = begin; i < end; ++i) {
+                    out[i] = (unpack(words, rows[i] - offset, block.bits) - first <= width) == inside;
+                }
+            }
+                break;
+            case RLE: {
+                const size_t runs = block.words.size() / 2;
+                size_t run = 0, previous = 0;
+                for (size_t i = begin; i < end; ++i) {
+                    const size_t position = rows[i] - offset;
+                    if (position < previous) {
+                        run = find_run(words, runs, position);
+                    }
+                    while (words[2 * run + 1] <= position) {
+                        ++run;
+                    }
+                    const int64_t value = static_cast<int64_t>(words[2 * run]);
+                    out[i] = (low <= value && value <= high) == inside;
+                    previous = position;
+                }
+            }
+                break;
+            default: { // PLAIN, DELTA: значение восстанавливается за O(1)
+                for (size_t i = begin; i < end; ++i) {
+                    const int64_t value = block.get(rows[i] - offset);
+                    out[i] = (low <= value && value <= high) == inside;
+                }
+            }
+                break;
+        }
+    });
+}
+
+
+const std::vector<Compressed_longs::Block> &Compressed_longs::get_blocks() const
+{
+    return blocks;
+}
+
+
+void Compressed_longs::push_block(Block block)
+{
+    records += block.count;
+    blocks.push_back(std::move(block));
+}
+
+
+Compressed_longs::Block Compressed_longs::sealed(const Block &block)
+{
+    Block copy = block;
+    seal(copy);
+    return copy;
+}
+
+
+void Compressed_longs::seal(Block &block)
+{
+    unseal(block); // способ выбирается заново по значениям как есть
+    const size_t count = block.count;
+    block.sealed = true;
+    if (count == 0) {
+        return;
+    }
+    const uint64_t *raw = block.words.data();
+    auto value = [raw](size_t i) { return static_cast<int64_t>(raw[i]); };
+
+    int64_t min = value(0), max = value(0);
+    size_t runs = 1;
+    bool ascending = true, descending = true;
+    for (size_t i = 1; i < count; ++i) {
+        const int64_t current = value(i), previous = value(i - 1);
+        min = std::min(min, current);
+        max = std::max(max, current);
+        runs += current != previous;
+        ascending &= current >= previous;
+        descending &= current <= previous;
+    }
+
+    // размеры в словах для каждого способа; при равенстве остаётся более простой
+    encoding best = PLAIN;
+    size_t best_size = count;
+    const unsigned packed_bits = bits_for(uint64_t(max) - uint64_t(min));
+    if (words_for(count, packed_bits) < best_size) {
+        best = PACKED;
+        best_size = words_for(count, packed_bits);
+    }
+    unsigned delta_bits = 0;
+    int64_t delta_base = 0, delta_step = 0;
+    if ((ascending || descending) && count > 1) {
+        // прямая через первое и последнее значения, отклонения от неё -- неотрицательные после сдвига
+        const __int128 first = value(0), step = (__int128(value(count - 1)) - first) / __int128(count - 1);
+        __int128 low = 0, high = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const __int128 deviation = value(i) - first - step * __int128(i);
+            low = std::min(low, deviation);
+            high = std::max(high, deviation);
+        }
+        const __int128 base = first + low;
+        if (high - low <= __int128(UINT64_MAX) && base >= INT64_MIN && base <= INT64_MAX) {
+            delta_bits = bits_for(static_cast<uint64_t>(high - low));
+            delta_base = static_cast<int64_t>(base);
+            delta_step = static_cast<int64_t>(step);
+            if (words_for(count, delta_bits) < best_size) {
+                best = DELTA;
+                best_size = words_for(count, delta_bits);
+            }
+        }
+    }
+    if (2 * runs < best_size) {
+        best = RLE;
+        best_size = 2 * runs;
+    }
+
+    if (best == PLAIN) {
+        return;
+    }
+    std::vector<uint64_t> words(best_size, 0);
+    switch (best) {
+        case PACKED:
+            for (size_t i = 0; i < count; ++i) {
+                pack(words, i, packed_bits, uint64_t(value(i)) - uint64_t(min));
+            }
+            block.bits = packed_bits;
+            block.base = min;
+            break;
+        case DELTA:
+            for (size_t i = 0; i < count; ++i) {
+                pack(words, i, delta_bits, uint64_t(value(i)) - uint64_t(delta_base) - uint64_t(delta_step) * i);
+            }
+            block.bits = delta_bits;
+            block.base = delta_base;
+            block.step = delta_step;
+            break;
+        default: { // RLE: [значение, конец серии (не включая)]
+            size_t run = 0;
+            for (size_t i = 1; i <= count; ++i) {
+                if (i == count || value(i) != value(i - 1)) {
+                    words[2 * run] = uint64_t(value(i - 1));
+                    words[2 * run + 1] = i;
+                    ++run;
+                }
+            }
+        }
+            break;
+    }
+    block.kind = best;
+    block.words.assign(std::move(words));
+}
+
+
+void Compressed_longs::unseal(Block &block)
+{
+    block.sealed = false;
+    if (block.kind == PLAIN) {
+        return;
+    }
+    std::vector<uint64_t> words(block.count);
+    for (size_t i = 0; i < block.count; ++i) {
+        words[i] = static_cast<uint64_t>(block.get(i));
+    }
+    block.kind = PLAIN;
+    block.bits = 0;
+    block.base = block.step = 0;
+    block.words.assign(std::move(words));
+}
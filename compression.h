@@ -0,0 +1,139 @@
+#ifndef SQL_INTERPRETER_COMPRESSION_H
+#define SQL_INTERPRETER_COMPRESSION_H
+
+#include <cstdint>  // int64_t, uint64_t, uint32_t, uint8_t
+#include <cstddef>  // size_t
+#include <vector>   // std::vector
+#include "mapped.h" // Mapped_vector
+
+/* ------------------------------------------------ */
+/* ------------------ COMPRESSION ----------------- */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] значения поля LONG хранятся блоками по BLOCK_SIZE строк; заполненный блок сжимается
+ *       тем способом, который для его значений короче:
+ *       PACKED -- разности с наименьшим значением блока, упакованные по <bits> бит;
+ *       DELTA  -- для монотонного блока: отклонения от прямой <base> + i * <step>, упакованные
+ *                 по <bits> бит (ключи с почти постоянным шагом занимают 0-2 бита на строку);
+ *       RLE    -- пары (значение, конец серии) для блоков из длинных серий одного значения;
+ *       PLAIN  -- значения как есть: последний, ещё не заполненный блок, изменённые блоки
+ *                 и блоки, которые не сжимаются
+ *       любая строка читается за O(1) (RLE -- двоичным поиском по сериям), а сравнения
+ *       с константой в PACKED-блоке выполняются над упакованными разностями
+ */
+class Compressed_longs
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 65536; // число строк в блоке
+
+    enum encoding : uint8_t
+    {
+        PLAIN = 0,
+        PACKED = 1,
+        DELTA = 2,
+        RLE = 3
+    }; // enum encoding
+
+    class Block
+    {
+    public:
+        encoding kind = PLAIN;         // способ хранения
+        uint8_t bits = 0;              // PACKED, DELTA: ширина упакованного значения
+        bool sealed = false;           // способ уже выбран по текущим значениям блока
+        uint32_t count = 0;            // число значений в блоке
+        int64_t base = 0;              // PACKED: наименьшее значение; DELTA: начало прямой
+        int64_t step = 0;              // DELTA: шаг прямой
+        Mapped_vector<uint64_t> words; // значения, упакованные значения или пары RLE
+
+        /**
+         * [get: returns the value <i> of the block]
+         */
+        int64_t get(size_t i) const;
+
+        /**
+         * [consistent: returns true if the <words> fit the encoding (checks a block read from a file)]
+         */
+        bool consistent() const;
+    }; // class Block
+
+    size_t size() const
+    {
+        return records;
+    }
+
+    bool empty() const
+    {
+        return records == 0;
+    }
+
+    int64_t operator[](size_t row) const
+    {
+        return blocks[row / BLOCK_SIZE].get(row % BLOCK_SIZE);
+    }
+
+    /**
+     * [set: writes <value> into the record <row>; the block is stored unpacked until compress()]
+     */
+    void set(size_t row, int64_t value);
+
+    /**
+     * [push_back: appends <value>; a block is compressed as soon as it is full]
+     */
+    void push_back(int64_t value);
+
+    /**
+     * [reserve: makes room for <capacity> records in total]
+     */
+    void reserve(size_t capacity);
+
+    void clear();
+
+    /**
+     * [compress: compresses again the full blocks changed by set()]
+     */
+    void compress();
+
+    /**
+     * [gather: writes the records <rows> to <out>]
+     */
+    void gather(const size_t *rows, size_t count, int64_t *out) const;
+
+    /**
+     * [select: writes to <out> 1 for the records <rows> with values in [<low>, <high>] and 0 for]
+     * [        the others (the other way round if not <inside>) without unpacking the values     ]
+     */
+    void select(const size_t *rows, size_t count, int64_t low, int64_t high, bool inside, int64_t *out) const;
+
+    /**
+     * [get_blocks: returns the blocks of the column]
+     */
+    const std::vector<Block> &get_blocks() const;
+
+    /**
+     * [push_block: appends a whole <block> read from a table file (all blocks but the last one]
+     * [            must hold BLOCK_SIZE records)                                              ]
+     */
+    void push_block(Block block);
+
+    /**
+     * [sealed: returns a compressed copy of the <block> (to save the unfinished last block)]
+     */
+    static Block sealed(const Block &block);
+
+private:
+    std::vector<Block> blocks; // все блоки, кроме последнего, полные
+    size_t records = 0;        // общее число значений
+
+    /**
+     * [seal: chooses the shortest encoding for the values of the PLAIN <block> and applies it]
+     */
+    static void seal(Block &block);
+
+    /**
+     * [unseal: turns the <block> back into PLAIN values in its own memory]
+     */
+    static void unseal(Block &block);
+}; // class Compressed_longs
+
+#endif // SQL_INTERPRETER_COMPRESSION_H
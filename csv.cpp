@@ -0,0 +1,202 @@
+#include <cstddef>      // size_t
+#include <cstdint>      // int64_t
+#include <string>       // std::string, std::to_string()
+#include <string_view>  // std::string_view: find(), substr(), remove_suffix()
+#include <vector>       // std::vector: resize(), push_back(), emplace_back()
+#include <thread>       // std::thread
+#include <functional>   // std::ref(), std::cref()
+#include <utility>      // std::move()
+#include <charconv>     // std::from_chars()
+#include <stdexcept>    // std::runtime_error
+#include <algorithm>    // std::min(), std::max()
+#include <cstdlib>      // realpath(), free()
+
+#include "csv.h" // прототипы всех функций, описанных в этом файле
+
+
+const size_t MIN_CHUNK_SIZE = 1u << 20; // меньшие части не окупают запуск потока
+
+std::string import_directory;
+
+
+/* -------------------- parse_csv -------------------- */
+
+/**
+ * [take_field: extracts from <line> at <pos> the next field (unquoting it into <chunk> if needed)]
+ * [            and moves <pos> past its comma; returns false if the quotes are broken          ]
+ */
+static bool take_field(std::string_view line, size_t &pos, Csv_chunk &chunk, std::string_view &field)
+{
+    if (pos < line.size() && line[pos] == '"') {
+        size_t close = line.find('"', pos + 1);
+        std::string unquoted;
+        bool doubled = false; // встретилась удвоенная кавычка: значение придётся переписать
+        while (close != std::string_view::npos && close + 1 < line.size() && line[close + 1] == '"') {
+            unquoted.append(line.data() + pos + 1, close + 1 - (pos + 1));
+            doubled = true;
+            pos = close + 1;
+            close = line.find('"', pos + 1);
+        }
+        if (close == std::string_view::npos || (close + 1 < line.size() && line[close + 1] != ',')) {
+            return false;
+        }
+        if (doubled) {
+            unquoted.append(line.data() + pos + 1, close - (pos + 1));
+            chunk.unquoted.push_back(std::move(unquoted));
+            field = chunk.unquoted.back();
+        } else {
+            field = line.substr(pos + 1, close - (pos + 1));
+        }
+        pos = close + 2;
+        return true;
+    }
+    size_t comma = line.find(',', pos);
+    if (comma == std::string_view::npos) {
+        comma = line.size();
+    }
+    field = line.substr(pos, comma - pos);
+    pos = comma + 1;
+    return true;
+}
+
+
+/**
+ * [parse_line: appends the values of one non-empty <line> to the <chunk>; returns false on error]
+ */
+static bool parse_line(std::string_view line, const std::vector<object_type> &types, Csv_chunk &chunk)
+{
+    size_t pos = 0;
+    std::string_view field;
+    for (size_t col = 0; col < types.size(); ++col) {
+        if (pos > line.size()) {
+            chunk.error = "expected " + std::to_string(types.size()) + " fields";
+            return false;
+        }
+        if (!take_field(line, pos, chunk, field)) {
+            chunk.error = "broken quotes in field " + std::to_string(col + 1);
+            return false;
+        }
+        if (types[col] == LONG) {
+            int64_t value;
+            auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+            if (field.empty() || result.ec != std::errc() || result.ptr != field.data() + field.size()) {
+                chunk.error = "bad LONG value '" + std::string(field) + "' in field " + std::to_string(col + 1);
+                return false;
+            }
+            chunk.columns[col].longs.push_back(value);
+        } else {
+            chunk.columns[col].texts.push_back(field);
+        }
+    }
+    if (pos <= line.size()) { // после последнего поля осталась запятая
+        chunk.error = "expected " + std::to_string(types.size()) + " fields";
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * [parse_chunk: parses the lines of <data> into the <chunk>, stopping at the first bad line]
+ */
+static void parse_chunk(std::string_view data, const std::vector<object_type> &types, Csv_chunk &chunk)
+{
+    chunk.columns.resize(types.size());
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t end = data.find('\n', pos);
+        if (end == std::string_view::npos) {
+            end = data.size();
+        }
+        std::string_view line = data.substr(pos, end - pos);
+        pos = end + 1;
+        ++chunk.lines;
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+        if (!parse_line(line, types, chunk)) {
+            chunk.error_line = chunk.lines;
+            return;
+        }
+        ++chunk.rows;
+    }
+}
+
+
+std::vector<Csv_chunk> parse_csv(std::string_view data, const std::vector<object_type> &types, size_t threads)
+{
+    // границы частей сдвигаются к началу следующей строки
+    size_t parts = std::max<size_t>(1, std::min(threads, data.size() / MIN_CHUNK_SIZE));
+    std::vector<size_t> bounds(1, 0);
+    for (size_t part = 1; part < parts; ++part) {
+        size_t bound = std::max(bounds.back(), data.size() / parts * part);
+        size_t end = data.find('\n', bound);
+        bounds.push_back(end == std::string_view::npos ? data.size() : end + 1);
+    }
+    bounds.push_back(data.size());
+
+    std::vector<Csv_chunk> chunks(parts);
+    std::vector<std::thread> workers;
+    for (size_t part = 1; part < parts; ++part) {
+        workers.emplace_back(parse_chunk, data.substr(bounds[part], bounds[part + 1] - bounds[part]),
+                             std::cref(types), std::ref(chunks[part]));
+    }
+    parse_chunk(data.substr(0, bounds[1]), types, chunks[0]);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    // номер строки ошибки -- сумма строк предыдущих частей и номер внутри своей
+    size_t line = 0;
+    for (const auto &chunk : chunks) {
+        if (!chunk.error.empty()) {
+            throw std::runtime_error("line " + std::to_string(line + chunk.error_line) + ": " + chunk.error);
+        }
+        line += chunk.lines;
+    }
+    return chunks;
+}
+
+
+/* -------------------- import_path -------------------- */
+
+/**
+ * [real_path: returns <path> with symbolic links, . and .. resolved (empty if it does not exist)]
+ */
+static std::string real_path(const std::string &path)
+{
+    char *resolved = realpath(path.c_str(), nullptr);
+    if (resolved == nullptr) {
+        return "";
+    }
+    std::string result(resolved);
+    free(resolved);
+    return result;
+}
+
+
+std::string import_path(const std::string &file_name)
+{
+    if (import_directory.empty()) {
+        throw std::runtime_error("COPY from files is disabled: the server has no import directory");
+    }
+    const std::string directory = real_path(import_directory);
+    if (directory.empty()) {
+        throw std::runtime_error("can't open the import directory");
+    }
+    // абсолютное имя проверяется как есть, относительное отсчитывается от каталога импорта
+    const std::string path = real_path(file_name.compare(0, 1, "/") == 0 ? file_name
+                                                                         : import_directory + "/" + file_name);
+    if (path.empty()) {
+        throw std::runtime_error("can't open file " + file_name);
+    }
+    // путь должен начинаться с каталога и разделителя: /data/import2 не лежит в /data/import
+    if (path.size() <= directory.size() || path.compare(0, directory.size(), directory) != 0 ||
+        (directory != "/" && path[directory.size()] != '/')) {
+        throw std::runtime_error("file " + file_name + " is outside the import directory");
+    }
+    return path;
+}
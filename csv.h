@@ -0,0 +1,67 @@
+#ifndef SQL_INTERPRETER_CSV_H
+#define SQL_INTERPRETER_CSV_H
+
+#include <cstddef>     // size_t
+#include <cstdint>     // int64_t
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <deque>       // std::deque
+#include <vector>      // std::vector
+
+#include "table.h"  // object_type
+#include "mapped.h" // Mapped_file
+
+/* ------------------------------------------------ */
+/* ---------------------- CSV --------------------- */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] файл CSV: запись на строку (\n или \r\n), поля через запятую, без строки заголовка;
+ *       поле TEXT можно заключить в двойные кавычки, кавычка внутри них удваивается ("");
+ *       перевод строки внутри поля не допускается, пустые строки пропускаются
+ */
+
+/**
+ * [NB!] часть файла, разобранная одним потоком: значения лежат по полям, в порядке строк
+ */
+class Csv_chunk
+{
+public:
+    class Column
+    {
+    public:
+        std::vector<int64_t> longs;          // значения поля LONG
+        std::vector<std::string_view> texts; // значения поля TEXT
+    }; // class Column
+
+    std::vector<Column> columns;      // по одному на поле таблицы
+    size_t rows = 0;                  // разобрано записей
+    size_t lines = 0;                 // просмотрено строк файла (вместе с пустыми)
+    std::deque<std::string> unquoted; // значения с удвоенными кавычками, переписанные без них
+    std::string error;                // первая ошибка в этой части (пусто, если её нет)
+    size_t error_line = 0;            // номер строки с ошибкой внутри этой части
+}; // class Csv_chunk
+
+
+/**
+ * [parse_csv: splits <data> into at most <threads> parts on line boundaries and parses them in]
+ * [           parallel into values of the <types>; throws std::runtime_error with the number ]
+ * [           of the first bad line                                                          ]
+ */
+std::vector<Csv_chunk> parse_csv(std::string_view data, const std::vector<object_type> &types, size_t threads);
+
+
+/**
+ * [NB!] COPY читает файлы только из каталога импорта (аргумент сервера): относительное имя файла
+ *       берётся от него, и путь после раскрытия символических ссылок и .. должен остаться
+ *       внутри каталога; пустой каталог импорта запрещает COPY из файлов
+ */
+extern std::string import_directory;
+
+/**
+ * [import_path: returns the real path of the file <file_name> in the import directory; throws]
+ * [             std::runtime_error if the file is missing or lies outside the directory     ]
+ */
+std::string import_path(const std::string &file_name);
+
+#endif // SQL_INTERPRETER_CSV_H
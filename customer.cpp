@@ -6,10 +6,86 @@
 #include <arpa/inet.h>
 #include <string.h>
 #include <string>
+#include <vector>
+#include <stdexcept>
+#include "protocol.h"    // put_frame(), take_frame()
 
-using namespace std; 
+using namespace std;
 
-int main(){
+const size_t BUF_SIZE = 65536; // сколько байт забираем из сокета за один recv
+const size_t PIPELINE = 256;   // сколько команд из файла/канала отправляем, не дожидаясь ответов
+
+
+/**
+ * [send_all: sends the whole <data>; returns false on error]
+ */
+static bool send_all(int sock, const string &data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t bytes = send(sock, data.data() + sent, data.size() - sent, 0);
+        if (bytes == -1) {
+            return false;
+        }
+        sent += bytes;
+    }
+    return true;
+}
+
+
+/**
+ * [read_frame: reads from <sock> the next answer frame, buffering extra bytes in <in>;]
+ * [            returns false if the connection is broken                              ]
+ */
+static bool read_frame(int sock, string &in, size_t &offset, frame_kind &kind, string &payload)
+{
+    static char buf[BUF_SIZE];
+    while (!take_frame(in, offset, kind, payload)) {
+        ssize_t bytes = recv(sock, buf, BUF_SIZE, 0);
+        if (bytes <= 0) {
+            return false;
+        }
+        in.erase(0, offset); // разобранные кадры больше не нужны
+        offset = 0;
+        in.append(buf, bytes);
+    }
+    return true;
+}
+
+
+/**
+ * [render: turns the rows decoded into <result> into text like the server's text answer;]
+ * [        <number> is the number of the next row, <header> -- whether the header is shown]
+ */
+static string render(Binary_result &result, size_t &number, bool &header)
+{
+    string text;
+    if (result.has_schema && !header) {
+        text += "\nSELECTED FROM: " + result.table_name + "\n--- COLUMNS: ";
+        for (size_t col = 0; col < result.columns.size(); ++col)
+            text += (col == 0 ? "" : " | ") + result.columns[col].name;
+        text += "\n";
+        header = true;
+    }
+    for (size_t row = 0; row < result.rows; ++row, ++number) {
+        text += to_string(number) + ": ";
+        for (size_t col = 0; col < result.columns.size(); ++col) {
+            const Binary_result::Column &column = result.columns[col];
+            if (col != 0)
+                text += " | ";
+            text += column.type == BINARY_LONG ? to_string(column.longs[row]) : column.texts[row];
+        }
+        text += "\n";
+    }
+    result.clear_rows(); // строки выведены: память не растёт с размером результата
+    return text;
+}
+
+
+int main(int argc, char *argv[]){
+
+    // с ключом -b результаты запрашиваются в двоичном виде и разбираются здесь
+    const bool binary = argc > 1 && string(argv[1]) == "-b";
 
     // создаем сокет
     int sock=socket(AF_INET, SOCK_STREAM, 0);
@@ -17,7 +93,7 @@ int main(){
     {
         return 1;
     }
-    // создаем структуру для соединения с сервером 
+    // создаем структуру для соединения с сервером
 
     int port = 54000;
     string ipAddress = "127.0.0.1";
@@ -25,53 +101,97 @@ int main(){
     sockaddr_in hint;
     hint.sin_family = AF_INET;
     hint.sin_port = htons(port);
-    inet_pton(AF_INET, "127.0.0.1", &hint.sin_addr);
+    inet_pton(AF_INET, ipAddress.c_str(), &hint.sin_addr);
 
     int connectRes = connect(sock, (sockaddr*)&hint, sizeof(hint));
     if (connectRes == -1)
     {
-        cout << "111111";
+        cout << "Could not connect to server\r\n";
         return 1;
     }
 
-    char buf[4096];
+    // с терминала команды идут по одной; из файла или канала -- пачками без ожидания ответов
+    const bool interactive = isatty(STDIN_FILENO);
+    string in;         // принятые байты (растёт под длинный ответ)
+    size_t offset = 0; // начало ещё не разобранной части <in>
     string userInput;
+    bool finished = false;
 
-    do {
-        //      Ввод строк 
-        cout << "> ";
-        getline(cin, userInput);
+    while (!finished) {
+        //      Ввод строк
+        string request;
+        size_t count = 0;
+        while (count < (interactive ? 1 : PIPELINE)) {
+            if (interactive)
+                cout << "> ";
+            if (!getline(cin, userInput)) {
+                finished = true;
+                break;
+            }
+            if (userInput.empty())
+                continue;
+            if (userInput == "END") {
+                put_frame(request, FRAME_END, "");
+                finished = true;
+            } else {
+                put_frame(request, binary ? FRAME_QUERY_BINARY : FRAME_QUERY, userInput);
+            }
+            ++count;
+            if (finished)
+                break;
+        }
+        if (count == 0)
+            break;
 
         //      отправляем в сервер
-        int sendRes = send(sock, userInput.c_str(), userInput.size() + 1, 0);
-        if (sendRes == -1)
+        if (!send_all(sock, request))
         {
             cout << "Could not send to server! Whoops!\r\n";
-            continue;
+            break;
         }
 
-        //      Ждем ответа от сервера
-        memset(buf, 0, 4096);
-        int bytesReceived = recv(sock, buf, 4096, 0);
-        if (strcmp(buf,"END")==0){
-            close(sock);
-            return 1;
+        //      Ждем ответов от сервера: по одному на каждую команду, в том же порядке;
+        //      длинный ответ приходит частями (FRAME_CHUNK), их выводим сразу
+        bool ended = false; // сервер завершил сеанс
+        for (size_t i = 0; i < count && !ended; ++i) {
+            frame_kind kind = FRAME_CHUNK;
+            string payload;
+            bool first = true;
+            Binary_result result;
+            size_t number = 0;
+            bool header = false;
+            while (kind == FRAME_CHUNK) {
+                try {
+                    if (!read_frame(sock, in, offset, kind, payload)) {
+                        cout << "There was an error getting response from server\r\n";
+                        close(sock);
+                        return 1;
+                    }
+                    if (binary && (kind == FRAME_CHUNK || kind == FRAME_OK)) {
+                        result.read(payload);
+                        payload = render(result, number, header);
+                    }
+                }
+                catch (length_error &error) {
+                    cout << "Bad response from server: " << error.what() << "\r\n";
+                    close(sock);
+                    return 1;
+                }
+                if (kind == FRAME_END) {
+                    ended = finished = true;
+                    break;
+                }
+                //      Display response
+                cout << (first ? "Сервер> " : "") << payload;
+                first = false;
+            }
+            if (!first)
+                cout << "\r\n";
         }
-        if (bytesReceived == -1)
-        {
-            cout << "There was an error getting response from server\r\n";
-        }
-        else
-        {
-            //      Display response
-            cout << "Сервер> " << string(buf, bytesReceived) << "\r\n";
-        }
-    } while(true);
+    }
 
-    //  Закрываем сокет 
+    //  Закрываем сокет
     close(sock);
 
     return 0;
 }
-
-
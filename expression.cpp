@@ -0,0 +1,560 @@
+#include <cstdint>     // int64_t
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <vector>      // std::vector: push_back(), resize(), size()
+#include <stdexcept>   // std::runtime_error
+#include <algorithm>   // std::max()
+#include <limits>      // std::numeric_limits
+
+#include "expression.h" // прототипы всех функций, описанных в этом файле
+
+
+/* -------------------- class Expression -------------------- */
+
+Expression::Expression() = default;
+
+
+void Expression::push(operation_type operation, const std::string &value)
+{
+    Item item;
+    item.operation = operation;
+    item.name = value;
+    if (operation == OP_NUMBER) {
+        item.number = to_long(value); // константу разбираем один раз
+    }
+    items.push_back(item);
+}
+
+
+bool Expression::empty() const
+{
+    return items.empty();
+}
+
+
+std::string Expression::column_name() const
+{
+    return items.size() == 1 && items[0].operation == OP_COLUMN ? items[0].name : "";
+}
+
+
+void Expression::terms(std::vector<Term> &result) const
+{
+    if (!items.empty()) {
+        collect_terms(0, items.size(), result);
+    }
+}
+
+
+size_t Expression::start_of(size_t last) const
+{
+    int need = 1; // сколько значений ещё должно оказаться на стеке
+    for (size_t i = last;; --i) {
+        operation_type operation = items[i].operation;
+        need += (operation <= OP_STRING ? 0 : operation == OP_NOT ? 1 : 2) - 1;
+        if (need == 0 || i == 0) {
+            return i;
+        }
+    }
+}
+
+
+void Expression::collect_terms(size_t begin, size_t end, std::vector<Term> &result) const
+{
+    const Item &last = items[end - 1];
+
+    if (last.operation == OP_AND) {
+        size_t right = start_of(end - 2); // правый операнд AND
+        collect_terms(right, end - 1, result);
+        collect_terms(begin, right, result);
+        return;
+    }
+    if (last.operation < OP_EQUAL || last.operation > OP_GREATER_OR_EQUAL || end - begin != 3) {
+        return;
+    }
+
+    const Item &left = items[begin], &right = items[begin + 1];
+    Term term;
+    term.operation = last.operation;
+    const Item *constant;
+    if (left.operation == OP_COLUMN && (right.operation == OP_NUMBER || right.operation == OP_STRING)) {
+        term.column = left.name;
+        constant = &right;
+    } else if (right.operation == OP_COLUMN && (left.operation == OP_NUMBER || left.operation == OP_STRING)) {
+        term.column = right.name;
+        constant = &left;
+        // константа слева: 5 < a == a > 5
+        switch (term.operation) {
+            case OP_LESS:             term.operation = OP_GREATER;          break;
+            case OP_GREATER:          term.operation = OP_LESS;             break;
+            case OP_LESS_OR_EQUAL:    term.operation = OP_GREATER_OR_EQUAL; break;
+            case OP_GREATER_OR_EQUAL: term.operation = OP_LESS_OR_EQUAL;    break;
+            default:                                                        break;
+        }
+    } else {
+        return;
+    }
+    term.type = constant->operation == OP_NUMBER ? LONG : TEXT;
+    term.number = constant->number;
+    term.text = constant->name;
+    result.push_back(term);
+}
+
+
+object_type Expression::bind(const Table &table)
+{
+    std::vector<object_type> types; // типы значений на стеке вычислений
+    size_t depth = 0;
+
+    for (auto &item : items) {
+        item.column = nullptr;
+        item.folded = false;
+        item.matches.clear();
+        switch (item.operation) {
+            case OP_COLUMN:
+                item.column = &table.table.at(item.name);
+                types.push_back(item.column->type);
+                break;
+
+            case OP_NUMBER:
+                types.push_back(LONG);
+                break;
+
+            case OP_STRING:
+                types.push_back(TEXT);
+                break;
+
+            case OP_NOT:
+                if (types.empty()) {
+                    throw std::runtime_error("incorrect expression");
+                }
+                types.back() = LONG;
+                break;
+
+            default: // бинарные операции
+                if (types.size() < 2) {
+                    throw std::runtime_error("incorrect expression");
+                }
+                if (types[types.size() - 2] != types.back()) {
+                    throw std::runtime_error("type mismatch in expression");
+                }
+                if (item.operation <= OP_MODULO && types.back() != LONG) {
+                    throw std::runtime_error("arithmetic operation on TEXT field");
+                }
+                types.pop_back();
+                types.back() = LONG;
+                break;
+        }
+        depth = std::max(depth, types.size());
+    }
+    if (types.size() != 1) {
+        throw std::runtime_error("incorrect expression");
+    }
+
+    for (size_t position = 2; position < items.size(); ++position) {
+        fold_dictionary(position);
+        fold_range(position);
+    }
+
+    stack.resize(depth);
+    return types.back();
+}
+
+
+void Expression::fold_dictionary(size_t position)
+{
+    Item &comparison = items[position];
+    if (comparison.operation < OP_EQUAL || comparison.operation > OP_GREATER_OR_EQUAL) {
+        return;
+    }
+    Item &left = items[position - 2], &right = items[position - 1];
+    // два операнда подряд перед бинарной операцией - это именно её операнды
+    const bool column_left = left.operation == OP_COLUMN && right.operation == OP_STRING;
+    const bool column_right = right.operation == OP_COLUMN && left.operation == OP_STRING;
+    if (!column_left && !column_right) {
+        return;
+    }
+    const Item &field = column_left ? left : right;
+    const std::string_view constant = column_left ? right.name : left.name;
+    if (!field.column->encoded) {
+        return;
+    }
+
+    comparison.column = field.column;
+    comparison.matches.resize(field.column->dictionary.size());
+    for (size_t code = 0; code < comparison.matches.size(); ++code) {
+        std::string_view value = field.column->dictionary[code];
+        comparison.matches[code] = column_left ? compare_text(comparison.operation, value, constant)
+                                               : compare_text(comparison.operation, constant, value);
+    }
+    left.folded = right.folded = true;
+}
+
+
+void Expression::fold_range(size_t position)
+{
+    Item &comparison = items[position];
+    if (comparison.operation < OP_EQUAL || comparison.operation > OP_GREATER_OR_EQUAL ||
+        comparison.column != nullptr) {
+        return;
+    }
+    Item &left = items[position - 2], &right = items[position - 1];
+    const bool column_left = left.operation == OP_COLUMN && right.operation == OP_NUMBER;
+    const bool column_right = right.operation == OP_COLUMN && left.operation == OP_NUMBER;
+    if ((!column_left && !column_right) || left.folded || right.folded) {
+        return;
+    }
+    const Item &field = column_left ? left : right;
+    if (field.column->type != LONG) {
+        return;
+    }
+    const int64_t value = column_left ? right.number : left.number;
+    operation_type operation = comparison.operation;
+    if (column_right) { // константа слева: 5 < a == a > 5
+        switch (operation) {
+            case OP_LESS:             operation = OP_GREATER;          break;
+            case OP_GREATER:          operation = OP_LESS;             break;
+            case OP_LESS_OR_EQUAL:    operation = OP_GREATER_OR_EQUAL; break;
+            case OP_GREATER_OR_EQUAL: operation = OP_LESS_OR_EQUAL;    break;
+            default:                                                   break;
+        }
+    }
+
+    // a < 5 -- это a в [INT64_MIN, 4]; пустой диапазон (a < INT64_MIN) задаётся <low> > <high>
+    const int64_t min = std::numeric_limits<int64_t>::min(), max = std::numeric_limits<int64_t>::max();
+    comparison.inside = true;
+    comparison.low = min;
+    comparison.high = max;
+    switch (operation) {
+        case OP_EQUAL:
+            comparison.low = comparison.high = value;
+            break;
+        case OP_NOT_EQUAL:
+            comparison.low = comparison.high = value;
+            comparison.inside = false;
+            break;
+        case OP_LESS:
+            comparison.low = value == min ? max : min;
+            comparison.high = value == min ? min : value - 1;
+            break;
+        case OP_LESS_OR_EQUAL:
+            comparison.high = value;
+            break;
+        case OP_GREATER:
+            comparison.low = value == max ? max : value + 1;
+            comparison.high = value == max ? min : max;
+            break;
+        default: // OP_GREATER_OR_EQUAL
+            comparison.low = value;
+            break;
+    }
+    comparison.column = field.column;
+    left.folded = right.folded = true;
+}
+
+
+bool Expression::compare_text(operation_type operation, std::string_view left, std::string_view right)
+{
+    switch (operation) {
+        case OP_EQUAL:            return left == right;
+        case OP_NOT_EQUAL:        return left != right;
+        case OP_LESS:             return left < right;
+        case OP_GREATER:          return left > right;
+        case OP_LESS_OR_EQUAL:    return left <= right;
+        case OP_GREATER_OR_EQUAL: return left >= right;
+        default:                  return false;
+    }
+}
+
+
+void Expression::evaluate(const size_t *rows, size_t count)
+{
+    size_t top = 0; // число занятых слотов стека
+
+    for (const auto &item : items) {
+        if (item.folded) {
+            continue;
+        }
+        switch (item.operation) {
+            case OP_COLUMN: {
+                Slot &slot = stack[top++];
+                slot.type = item.column->type;
+                slot.constant = false;
+                if (slot.type == LONG) {
+                    slot.numbers.resize(count);
+                    item.column->long_data.gather(rows, count, slot.numbers.data());
+                } else if (item.column->encoded) {
+                    slot.texts.resize(count);
+                    const uint32_t *codes = item.column->codes.data();
+                    const std::string_view *dictionary = item.column->dictionary.data();
+                    for (size_t i = 0; i < count; ++i) {
+                        slot.texts[i] = Short_string(dictionary[codes[rows[i]]]);
+                    }
+                } else {
+                    slot.texts.resize(count);
+                    const Short_string *data = item.column->text_data.data();
+                    for (size_t i = 0; i < count; ++i) {
+                        slot.texts[i] = data[rows[i]];
+                    }
+                }
+            }
+                break;
+
+            case OP_NUMBER: {
+                Slot &slot = stack[top++];
+                slot.type = LONG;
+                slot.constant = true;
+                slot.number = item.number;
+            }
+                break;
+
+            case OP_STRING: {
+                Slot &slot = stack[top++];
+                slot.type = TEXT;
+                slot.constant = true;
+                slot.text = Short_string(item.name);
+            }
+                break;
+
+            case OP_PLUS:
+            case OP_MINUS:
+            case OP_MULTIPLY:
+            case OP_DIVIDE:
+            case OP_MODULO:
+                arithmetic(item.operation, stack[top - 2], stack[top - 1], count);
+                --top;
+                break;
+
+            case OP_AND:
+            case OP_OR:
+                logic(item.operation, stack[top - 2], stack[top - 1], count);
+                --top;
+                break;
+
+            case OP_NOT: {
+                Slot &slot = stack[top - 1];
+                if (slot.constant) {
+                    slot.number = !slot.number;
+                } else {
+                    for (size_t i = 0; i < count; ++i) {
+                        slot.numbers[i] = !slot.numbers[i];
+                    }
+                }
+            }
+                break;
+
+            default: // операции сравнения
+                if (item.column != nullptr && item.column->type == LONG) { // сравнение без распаковки
+                    Slot &slot = stack[top++];
+                    slot.type = LONG;
+                    slot.constant = false;
+                    slot.numbers.resize(count);
+                    item.column->long_data.select(rows, count, item.low, item.high, item.inside,
+                                                  slot.numbers.data());
+                } else if (item.column != nullptr) { // сравнение поля-словаря с константой: сравниваем коды
+                    Slot &slot = stack[top++];
+                    slot.type = LONG;
+                    slot.constant = false;
+                    slot.numbers.resize(count);
+                    const uint32_t *codes = item.column->codes.data();
+                    const char *matches = item.matches.data();
+                    for (size_t i = 0; i < count; ++i) {
+                        slot.numbers[i] = matches[codes[rows[i]]];
+                    }
+                } else {
+                    compare(item.operation, stack[top - 2], stack[top - 1], count);
+                    --top;
+                }
+                break;
+        }
+    }
+    result = top - 1;
+}
+
+
+bool Expression::is_constant() const
+{
+    return stack[result].constant;
+}
+
+
+int64_t Expression::long_result(size_t i) const
+{
+    const Slot &slot = stack[result];
+    return slot.constant ? slot.number : slot.numbers[i];
+}
+
+
+const Short_string &Expression::text_result(size_t i) const
+{
+    const Slot &slot = stack[result];
+    return slot.constant ? slot.text : slot.texts[i];
+}
+
+
+template <>
+const int64_t &Expression::constant_of<int64_t>(const Slot &slot)
+{
+    return slot.number;
+}
+
+
+template <>
+const Short_string &Expression::constant_of<Short_string>(const Slot &slot)
+{
+    return slot.text;
+}
+
+
+template <>
+const std::vector<int64_t> &Expression::values_of<int64_t>(const Slot &slot)
+{
+    return slot.numbers;
+}
+
+
+template <>
+const std::vector<Short_string> &Expression::values_of<Short_string>(const Slot &slot)
+{
+    return slot.texts;
+}
+
+
+template <class Value, class Function>
+void Expression::apply(Slot &left, const Slot &right, size_t count, Function function)
+{
+    if (left.constant && right.constant) {
+        left.number = function(constant_of<Value>(left), constant_of<Value>(right));
+    } else {
+        std::vector<int64_t> &out = left.numbers; // результат пишем поверх левого операнда
+        out.resize(count);
+        if (left.constant) {
+            const Value value = constant_of<Value>(left);
+            const std::vector<Value> &values = values_of<Value>(right);
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = function(value, values[i]);
+            }
+        } else if (right.constant) {
+            const Value &value = constant_of<Value>(right);
+            const std::vector<Value> &values = values_of<Value>(left);
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = function(values[i], value);
+            }
+        } else {
+            const std::vector<Value> &left_values = values_of<Value>(left);
+            const std::vector<Value> &right_values = values_of<Value>(right);
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = function(left_values[i], right_values[i]);
+            }
+        }
+        left.constant = false;
+    }
+    left.type = LONG;
+}
+
+
+void Expression::arithmetic(operation_type operation, Slot &left, const Slot &right, size_t count)
+{
+    // переполнение - ошибка команды, а не молча перевернувшийся знак (и не SIGFPE при делении)
+    switch (operation) {
+        case OP_PLUS:
+            apply<int64_t>(left, right, count, [](int64_t a, int64_t b) {
+                int64_t result;
+                if (__builtin_add_overflow(a, b, &result)) {
+                    throw std::runtime_error("integer overflow");
+                }
+                return result;
+            });
+            break;
+        case OP_MINUS:
+            apply<int64_t>(left, right, count, [](int64_t a, int64_t b) {
+                int64_t result;
+                if (__builtin_sub_overflow(a, b, &result)) {
+                    throw std::runtime_error("integer overflow");
+                }
+                return result;
+            });
+            break;
+        case OP_MULTIPLY:
+            apply<int64_t>(left, right, count, [](int64_t a, int64_t b) {
+                int64_t result;
+                if (__builtin_mul_overflow(a, b, &result)) {
+                    throw std::runtime_error("integer overflow");
+                }
+                return result;
+            });
+            break;
+        case OP_DIVIDE:
+            apply<int64_t>(left, right, count, [](int64_t a, int64_t b) {
+                if (b == 0) {
+                    throw std::runtime_error("division by zero");
+                }
+                if (b == -1 && a == std::numeric_limits<int64_t>::min()) {
+                    throw std::runtime_error("integer overflow");
+                }
+                return a / b;
+            });
+            break;
+        case OP_MODULO:
+            apply<int64_t>(left, right, count, [](int64_t a, int64_t b) {
+                if (b == 0) {
+                    throw std::runtime_error("division by zero");
+                }
+                if (b == -1 && a == std::numeric_limits<int64_t>::min()) {
+                    throw std::runtime_error("integer overflow");
+                }
+                return a % b;
+            });
+            break;
+        default:
+            break;
+    }
+}
+
+
+template <class Value>
+void Expression::compare_values(operation_type operation, Slot &left, const Slot &right, size_t count)
+{
+    switch (operation) {
+        case OP_EQUAL:
+            apply<Value>(left, right, count, [](const Value &a, const Value &b) -> int64_t { return a == b; });
+            break;
+        case OP_NOT_EQUAL:
+            apply<Value>(left, right, count, [](const Value &a, const Value &b) -> int64_t { return a != b; });
+            break;
+        case OP_LESS:
+            apply<Value>(left, right, count, [](const Value &a, const Value &b) -> int64_t { return a < b; });
+            break;
+        case OP_GREATER:
+            apply<Value>(left, right, count, [](const Value &a, const Value &b) -> int64_t { return a > b; });
+            break;
+        case OP_LESS_OR_EQUAL:
+            apply<Value>(left, right, count, [](const Value &a, const Value &b) -> int64_t { return a <= b; });
+            break;
+        case OP_GREATER_OR_EQUAL:
+            apply<Value>(left, right, count, [](const Value &a, const Value &b) -> int64_t { return a >= b; });
+            break;
+        default:
+            break;
+    }
+}
+
+
+void Expression::compare(operation_type operation, Slot &left, const Slot &right, size_t count)
+{
+    if (left.type == LONG) {
+        compare_values<int64_t>(operation, left, right, count);
+    } else {
+        compare_values<Short_string>(operation, left, right, count); // строки чаще всего различаются по префиксу
+    }
+}
+
+
+void Expression::logic(operation_type operation, Slot &left, const Slot &right, size_t count)
+{
+    if (operation == OP_AND) {
+        apply<int64_t>(left, right, count, [](int64_t a, int64_t b) -> int64_t { return a && b; });
+    } else {
+        apply<int64_t>(left, right, count, [](int64_t a, int64_t b) -> int64_t { return a || b; });
+    }
+}
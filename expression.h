@@ -0,0 +1,184 @@
+#ifndef SQL_INTERPRETER_EXPRESSION_H
+#define SQL_INTERPRETER_EXPRESSION_H
+
+#include <cstdint>     // int64_t
+#include <cstddef>     // size_t
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <vector>      // std::vector
+#include "table.h"
+
+/* ------------------------------------------------ */
+/* ------------------ EXPRESSION ------------------ */
+/* ------------------------------------------------ */
+
+enum operation_type
+{
+    /* операнды */
+    OP_COLUMN,
+    OP_NUMBER,
+    OP_STRING,
+    /* арифметические операции */
+    OP_PLUS,
+    OP_MINUS,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_MODULO,
+    /* операции сравнения */
+    OP_EQUAL,
+    OP_NOT_EQUAL,
+    OP_LESS,
+    OP_GREATER,
+    OP_LESS_OR_EQUAL,
+    OP_GREATER_OR_EQUAL,
+    /* логические операции */
+    OP_AND,
+    OP_OR,
+    OP_NOT
+}; // enum operation_type
+
+class Expression
+{
+public:
+    static constexpr size_t BATCH_SIZE = 1024; // сколько строк вычисляется за один проход
+
+    class Term
+    {
+    public:
+        std::string column;       // имя поля
+        operation_type operation; // операция сравнения (поле всегда слева от константы)
+        object_type type;         // тип константы
+        int64_t number = 0;       // значение константы LONG
+        std::string text;         // значение константы TEXT
+    }; // class Term
+
+    /**
+     * [constructor: default]
+     */
+    Expression();
+
+    /**
+     * [push: appends the next element of the expression written in reverse polish notation]
+     */
+    void push(operation_type operation, const std::string &value = "");
+
+    /**
+     * [empty: returns true if the expression has no elements]
+     */
+    bool empty() const;
+
+    /**
+     * [column_name: returns the field name if the expression is a single field; "" otherwise]
+     */
+    std::string column_name() const;
+
+    /**
+     * [terms: appends to <result> the conditions <field> <comparison> <constant>]
+     * [       joined by AND at the top level of the expression                  ]
+     */
+    void terms(std::vector<Term> &result) const;
+
+    /**
+     * [bind: resolves field names in the <table>, returns the type of the result]
+     * [      (comparisons and logical operations give LONG with values 0 and 1)  ]
+     */
+    object_type bind(const Table &table);
+
+    /**
+     * [evaluate: computes the expression for <count> rows <rows> of the bound table]
+     * [          (<count> must not exceed BATCH_SIZE)                              ]
+     */
+    void evaluate(const size_t *rows, size_t count);
+
+    /**
+     * [is_constant: returns true if the last result is the same for all rows]
+     */
+    bool is_constant() const;
+
+    /**
+     * [long_result/text_result: return the i-th value of the last result]
+     */
+    int64_t long_result(size_t i) const;
+    const Short_string &text_result(size_t i) const;
+
+private:
+    class Item
+    {
+    public:
+        operation_type operation;     // тип элемента
+        std::string name;             // имя поля или значение константы
+        int64_t number = 0;           // значение числовой константы
+        const Table::Column *column = nullptr; // поле таблицы (после bind)
+        bool folded = false;                   // операнд уже учтён в сравнении по словарю или диапазону
+        std::vector<char> matches;             // результат сравнения для каждого кода словаря <column>
+        int64_t low = 0, high = 0;             // сравнение поля LONG <column> с константой как
+        bool inside = true;                    // проверка <low> <= значение <= <high> (или её отрицание)
+    }; // class Item
+
+    class Slot
+    {
+    public:
+        object_type type = NONE;
+        bool constant = false;               // значение одинаково для всех строк
+        int64_t number = 0;                  // значение-константа LONG
+        Short_string text;                   // значение-константа TEXT
+        std::vector<int64_t> numbers;        // значения LONG (и логические 0/1) по строкам
+        std::vector<Short_string> texts;     // значения TEXT по строкам
+    }; // class Slot
+
+    std::vector<Item> items; // выражение в ПОЛИЗе
+    std::vector<Slot> stack; // стек вычислений, буферы переиспользуются между проходами
+    size_t result = 0;       // позиция результата в <stack>
+
+    /**
+     * [start_of: returns the position of the first element of the subexpression ending at <last>]
+     */
+    size_t start_of(size_t last) const;
+
+    /**
+     * [collect_terms: looks for terms in the subexpression [<begin>, <end>)]
+     */
+    void collect_terms(size_t begin, size_t end, std::vector<Term> &result) const;
+
+    /**
+     * [fold_dictionary: if the comparison <position> compares a dictionary-encoded field]
+     * [                 with a constant, evaluates it once per dictionary entry         ]
+     */
+    void fold_dictionary(size_t position);
+
+    /**
+     * [fold_range: if the comparison <position> compares a LONG field with a constant, turns it]
+     * [            into a range check evaluated over the compressed values of the field        ]
+     */
+    void fold_range(size_t position);
+
+    /**
+     * [compare_text: returns the result of the comparison <operation> of two strings]
+     */
+    static bool compare_text(operation_type operation, std::string_view left, std::string_view right);
+
+    /**
+     * [arithmetic/compare/logic: apply the binary <operation> to the two top slots,]
+     * [                          the result is written to the <left> slot          ]
+     */
+    static void arithmetic(operation_type operation, Slot &left, const Slot &right, size_t count);
+    static void compare(operation_type operation, Slot &left, const Slot &right, size_t count);
+    static void logic(operation_type operation, Slot &left, const Slot &right, size_t count);
+
+    template <class Value>
+    static void compare_values(operation_type operation, Slot &left, const Slot &right, size_t count);
+
+    /**
+     * [apply: computes <function> over the values of the slots, taking constants into account]
+     */
+    template <class Value, class Function>
+    static void apply(Slot &left, const Slot &right, size_t count, Function function);
+
+    template <class Value>
+    static const Value &constant_of(const Slot &slot);
+
+    template <class Value>
+    static const std::vector<Value> &values_of(const Slot &slot);
+}; // class Expression
+
+#endif // SQL_INTERPRETER_EXPRESSION_H
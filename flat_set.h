@@ -0,0 +1,129 @@
+#ifndef SQL_INTERPRETER_FLAT_SET_H
+#define SQL_INTERPRETER_FLAT_SET_H
+
+#include <cstdint>     // int64_t, uint64_t
+#include <cstddef>     // size_t
+#include <string_view> // std::string_view, std::hash<std::string_view>
+#include <functional>  // std::hash
+#include <vector>      // std::vector
+#include "short_string.h" // Short_string
+
+/* ------------------------------------------------ */
+/* ------------------- FLAT SET ------------------- */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] множество констант списка IN: Key - int64_t или Short_string;
+ *       длинные строки Short_string хранит вызывающий, множество держит только ссылки
+ */
+template <class Key>
+class Flat_set
+{
+public:
+    /**
+     * [insert: adds <key> if it is not in the set yet]
+     */
+    void insert(Key key)
+    {
+        if (contains(key)) {
+            return;
+        }
+        keys.push_back(key);
+        if (keys.size() > LINEAR_LIMIT) {
+            if (keys.size() * 2 > slots.size()) { // заполненность таблицы не больше 1/2
+                rehash();
+            } else {
+                place(key);
+            }
+        }
+    }
+
+    /**
+     * [contains: returns true if <key> is in the set]
+     */
+    bool contains(Key key) const
+    {
+        if (keys.size() <= LINEAR_LIMIT) { // короткий список: просмотр без ветвлений по всем ключам
+            bool found = false;
+            for (const Key &value : keys) {
+                found |= value == key;
+            }
+            return found;
+        }
+        for (size_t slot = hash(key) & mask;; slot = (slot + 1) & mask) {
+            if (!used[slot]) {
+                return false;
+            }
+            if (slots[slot] == key) {
+                return true;
+            }
+        }
+    }
+
+    /**
+     * [values: returns the keys in insertion order]
+     */
+    const std::vector<Key> &values() const
+    {
+        return keys;
+    }
+
+    bool empty() const
+    {
+        return keys.empty();
+    }
+
+    void clear()
+    {
+        keys.clear();
+        slots.clear();
+        used.clear();
+        mask = 0;
+    }
+
+private:
+    static const size_t LINEAR_LIMIT = 8; // до стольких ключей хеш-таблица не строится
+
+    std::vector<Key> keys;   // ключи в порядке добавления
+    std::vector<Key> slots;  // открытая адресация с линейным пробированием
+    std::vector<char> used;  // занятость ячеек <slots>
+    size_t mask = 0;         // размер таблицы - 1 (размер - степень двойки)
+
+    static size_t hash(int64_t key)
+    {
+        // мультипликативное хеширование: старшие биты произведения перемешаны лучше
+        uint64_t product = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(product ^ (product >> 32));
+    }
+
+    static size_t hash(const Short_string &key)
+    {
+        return std::hash<std::string_view>()(key.view());
+    }
+
+    void place(Key key)
+    {
+        size_t slot = hash(key) & mask;
+        while (used[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = key;
+        used[slot] = true;
+    }
+
+    void rehash()
+    {
+        size_t capacity = 16;
+        while (capacity < keys.size() * 4) {
+            capacity *= 2;
+        }
+        slots.assign(capacity, Key());
+        used.assign(capacity, false);
+        mask = capacity - 1;
+        for (const Key &key : keys) {
+            place(key);
+        }
+    }
+}; // class Flat_set
+
+#endif // SQL_INTERPRETER_FLAT_SET_H
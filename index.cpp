@@ -0,0 +1,355 @@
+#include <cstdint>       // int64_t
+#include <string>        // std::string
+#include <string_view>   // std::string_view
+#include <unordered_map> // std::unordered_map: find(), erase(), clear()
+#include <vector>        // std::vector: push_back(), insert(), erase()
+#include <utility>       // std::pair, std::move()
+#include <algorithm>     // std::sort(), std::binary_search(), std::remove_if(), std::lower_bound(),
+                         // std::upper_bound(), std::copy()
+
+#include "index.h" // прототипы всех функций, описанных в этом файле
+
+
+namespace
+{
+    // удаляет строки <entries> из списков их значений: список каждого значения просматривается
+    // один раз, иначе удаление многих строк одного значения квадратично;
+    // <erased> вызывается для каждого значения, у которого не осталось строк
+    template <class Map, class Key, class Erased>
+    void erase_rows(Map &index, std::vector<std::pair<Key, size_t>> &entries, Erased erased)
+    {
+        std::sort(entries.begin(), entries.end()); // строки одного значения идут подряд и по возрастанию
+        std::vector<size_t> removed;
+        for (size_t begin = 0, end = 0; begin < entries.size(); begin = end) {
+            removed.clear();
+            for (end = begin; end < entries.size() && entries[end].first == entries[begin].first; ++end) {
+                removed.push_back(entries[end].second);
+            }
+            auto it = index.find(entries[begin].first);
+            if (it == index.end()) {
+                continue;
+            }
+            auto &rows = it->second;
+            rows.erase(std::remove_if(rows.begin(), rows.end(), [&removed](size_t row) {
+                return std::binary_search(removed.begin(), removed.end(), row);
+            }), rows.end());
+            if (rows.empty()) {
+                erased(it->first);
+                index.erase(it);
+            }
+        }
+    }
+}
+
+
+/* -------------------- class Hash_index -------------------- */
+
+Hash_index::Hash_index() = default;
+
+
+Hash_index::Hash_index(const std::string &column_name) : column_name(column_name)
+{}
+
+
+const std::string &Hash_index::column() const
+{
+    return column_name;
+}
+
+
+void Hash_index::insert(int64_t key, size_t row)
+{
+    long_index[key].push_back(row);
+}
+
+
+void Hash_index::insert(std::string_view key, size_t row)
+{
+    auto it = text_index.find(key);
+    if (it == text_index.end()) { // новое значение копируется в арену индекса один раз
+        it = text_index.emplace(text_keys.store(key), std::vector<size_t>()).first;
+    }
+    it->second.push_back(row);
+}
+
+
+void Hash_index::erase(std::vector<std::pair<int64_t, size_t>> &entries)
+{
+    erase_rows(long_index, entries, [](int64_t) {});
+}
+
+
+void Hash_index::erase(std::vector<std::pair<std::string_view, size_t>> &entries)
+{
+    erase_rows(text_index, entries, [this](std::string_view key) { text_keys.forget(key); });
+    if (text_keys.garbage() >= String_arena::CHUNK_LIMIT && 2 * text_keys.garbage() > text_keys.size()) {
+        pack_keys(); // больше половины байт арены уже не нужны
+    }
+}
+
+
+void Hash_index::find(int64_t key, std::vector<size_t> &rows) const
+{
+    auto it = long_index.find(key);
+    if (it != long_index.end()) {
+        rows.insert(rows.end(), it->second.begin(), it->second.end());
+    }
+}
+
+
+void Hash_index::find(std::string_view key, std::vector<size_t> &rows) const
+{
+    auto it = text_index.find(key);
+    if (it != text_index.end()) {
+        rows.insert(rows.end(), it->second.begin(), it->second.end());
+    }
+}
+
+
+void Hash_index::clear()
+{
+    long_index.clear();
+    text_index.clear();
+    text_keys.clear();
+}
+
+
+void Hash_index::pack_keys()
+{
+    String_arena packed;
+    std::unordered_map<std::string_view, std::vector<size_t>> packed_index;
+    packed_index.reserve(text_index.size());
+    for (auto &value : text_index) {
+        packed_index.emplace(packed.store(value.first), std::move(value.second));
+    }
+    text_index = std::move(packed_index);
+    text_keys = std::move(packed);
+}
+
+
+
+/* -------------------- class Btree_index -------------------- */
+
+Btree_index::Btree_index() = default;
+
+
+Btree_index::Btree_index(const std::string &column_name) : column_name(column_name)
+{}
+
+
+const std::string &Btree_index::column() const
+{
+    return column_name;
+}
+
+
+Btree_index::Leaf *Btree_index::new_leaf()
+{
+    leaves.emplace_back();
+    leaves.back().leaf = true;
+    return &leaves.back();
+}
+
+
+Btree_index::Inner *Btree_index::new_inner()
+{
+    inners.emplace_back();
+    inners.back().leaf = false;
+    return &inners.back();
+}
+
+
+Btree_index::Leaf *Btree_index::find_leaf(const Entry &entry) const
+{
+    Node *node = root;
+    while (node != nullptr && !node->leaf) {
+        const Inner *inner = static_cast<const Inner *>(node);
+        int i = std::upper_bound(inner->keys, inner->keys + inner->count, entry) - inner->keys;
+        node = inner->children[i];
+    }
+    return static_cast<Leaf *>(node);
+}
+
+
+void Btree_index::insert(int64_t key, size_t row)
+{
+    Entry entry{key, row};
+    if (root == nullptr) {
+        root = new_leaf();
+    }
+
+    Entry split_key;
+    Node *split;
+    if (insert_into(root, entry, split_key, split)) { // корень разделился: дерево растёт вверх
+        Inner *new_root = new_inner();
+        new_root->count = 1;
+        new_root->keys[0] = split_key;
+        new_root->children[0] = root;
+        new_root->children[1] = split;
+        root = new_root;
+    }
+}
+
+
+bool Btree_index::insert_into(Node *node, const Entry &entry, Entry &split_key, Node *&split)
+{
+    if (node->leaf) {
+        Leaf *leaf = static_cast<Leaf *>(node);
+        Entry buffer[CAPACITY + 1];
+        int pos = std::lower_bound(leaf->entries, leaf->entries + leaf->count, entry) - leaf->entries;
+        if (leaf->count < CAPACITY) {
+            std::copy_backward(leaf->entries + pos, leaf->entries + leaf->count, leaf->entries + leaf->count + 1);
+            leaf->entries[pos] = entry;
+            ++leaf->count;
+            return false;
+        }
+        // лист полон: делим пополам
+        std::copy(leaf->entries, leaf->entries + pos, buffer);
+        buffer[pos] = entry;
+        std::copy(leaf->entries + pos, leaf->entries + CAPACITY, buffer + pos + 1);
+
+        Leaf *right = new_leaf();
+        int half = (CAPACITY + 1) / 2;
+        leaf->count = half;
+        std::copy(buffer, buffer + half, leaf->entries);
+        right->count = CAPACITY + 1 - half;
+        std::copy(buffer + half, buffer + CAPACITY + 1, right->entries);
+        right->next = leaf->next;
+        leaf->next = right;
+
+        split_key = right->entries[0];
+        split = right;
+        return true;
+    }
+
+    Inner *inner = static_cast<Inner *>(node);
+    int i = std::upper_bound(inner->keys, inner->keys + inner->count, entry) - inner->keys;
+    Entry child_key;
+    Node *child_split;
+    if (!insert_into(inner->children[i], entry, child_key, child_split)) {
+        return false;
+    }
+
+    if (inner->count < CAPACITY) {
+        std::copy_backward(inner->keys + i, inner->keys + inner->count, inner->keys + inner->count + 1);
+        std::copy_backward(inner->children + i + 1, inner->children + inner->count + 1,
+                           inner->children + inner->count + 2);
+        inner->keys[i] = child_key;
+        inner->children[i + 1] = child_split;
+        ++inner->count;
+        return false;
+    }
+
+    // внутренний узел полон: средний ключ поднимается на уровень выше
+    Entry keys[CAPACITY + 1];
+    Node *children[CAPACITY + 2];
+    std::copy(inner->keys, inner->keys + i, keys);
+    keys[i] = child_key;
+    std::copy(inner->keys + i, inner->keys + CAPACITY, keys + i + 1);
+    std::copy(inner->children, inner->children + i + 1, children);
+    children[i + 1] = child_split;
+    std::copy(inner->children + i + 1, inner->children + CAPACITY + 1, children + i + 2);
+
+    Inner *right = new_inner();
+    int half = (CAPACITY + 1) / 2;
+    inner->count = half;
+    std::copy(keys, keys + half, inner->keys);
+    std::copy(children, children + half + 1, inner->children);
+    right->count = CAPACITY - half;
+    std::copy(keys + half + 1, keys + CAPACITY + 1, right->keys);
+    std::copy(children + half + 1, children + CAPACITY + 2, right->children);
+
+    split_key = keys[half];
+    split = right;
+    return true;
+}
+
+
+void Btree_index::erase(int64_t key, size_t row)
+{
+    Entry entry{key, row};
+    Leaf *leaf = find_leaf(entry);
+    if (leaf == nullptr) {
+        return;
+    }
+    int pos = std::lower_bound(leaf->entries, leaf->entries + leaf->count, entry) - leaf->entries;
+    if (pos < leaf->count && leaf->entries[pos].key == key && leaf->entries[pos].row == row) {
+        std::copy(leaf->entries + pos + 1, leaf->entries + leaf->count, leaf->entries + pos);
+        --leaf->count; // пустой лист остаётся в цепочке до перестроения
+    }
+}
+
+
+void Btree_index::build(std::vector<std::pair<int64_t, size_t>> &entries)
+{
+    clear();
+    if (entries.empty()) {
+        return;
+    }
+    std::sort(entries.begin(), entries.end());
+
+    // листья заполняем на 3/4, чтобы последующие вставки не сразу делили узлы
+    const size_t fill = CAPACITY * 3 / 4;
+    std::vector<Node *> level;
+    std::vector<Entry> first; // наименьшая запись каждого поддерева уровня
+    Leaf *previous = nullptr;
+    for (size_t begin = 0; begin < entries.size(); begin += fill) {
+        Leaf *leaf = new_leaf();
+        size_t end = std::min(begin + fill, entries.size());
+        for (size_t i = begin; i < end; ++i) {
+            leaf->entries[leaf->count++] = Entry{entries[i].first, entries[i].second};
+        }
+        if (previous != nullptr) {
+            previous->next = leaf;
+        }
+        previous = leaf;
+        level.push_back(leaf);
+        first.push_back(leaf->entries[0]);
+    }
+
+    // строим внутренние уровни снизу вверх
+    while (level.size() > 1) {
+        std::vector<Node *> upper;
+        std::vector<Entry> upper_first;
+        for (size_t begin = 0; begin < level.size(); begin += fill + 1) {
+            Inner *inner = new_inner();
+            size_t end = std::min(begin + fill + 1, level.size());
+            inner->children[0] = level[begin];
+            for (size_t i = begin + 1; i < end; ++i) {
+                inner->keys[inner->count] = first[i];
+                inner->children[++inner->count] = level[i];
+            }
+            upper.push_back(inner);
+            upper_first.push_back(first[begin]);
+        }
+        level.swap(upper);
+        first.swap(upper_first);
+    }
+    root = level[0];
+}
+
+
+void Btree_index::range(int64_t low, int64_t high, std::vector<size_t> &rows) const
+{
+    if (low > high) {
+        return;
+    }
+    Entry from{low, 0};
+    for (const Leaf *leaf = find_leaf(from); leaf != nullptr; leaf = leaf->next) {
+        int pos = std::lower_bound(leaf->entries, leaf->entries + leaf->count, from) - leaf->entries;
+        for (; pos < leaf->count; ++pos) {
+            if (leaf->entries[pos].key > high) {
+                return;
+            }
+            rows.push_back(leaf->entries[pos].row);
+        }
+    }
+}
+
+
+void Btree_index::clear()
+{
+    root = nullptr;
+    leaves.clear();
+    inners.clear();
+}
@@ -0,0 +1,187 @@
+#ifndef SQL_INTERPRETER_INDEX_H
+#define SQL_INTERPRETER_INDEX_H
+
+#include <cstdint>       // int64_t
+#include <cstddef>       // size_t
+#include <string>        // std::string
+#include <string_view>   // std::string_view
+#include <unordered_map> // std::unordered_map
+#include <vector>        // std::vector
+#include <deque>         // std::deque
+#include <utility>       // std::pair
+
+#include "arena.h"       // String_arena
+
+/* ------------------------------------------------ */
+/* -------------------- INDEX --------------------- */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] индекс хранит номера строк таблицы; после уплотнения таблицы
+ *       (Table::compact) номера меняются и индекс строится заново;
+ *       значения TEXT хранятся в собственной арене индекса, и поиск по ним не выделяет память
+ */
+class Hash_index
+{
+public:
+    /**
+     * [constructor: default]
+     */
+    Hash_index();
+
+    /**
+     * [constructor: creates an empty index on the field <column_name>]
+     */
+    explicit Hash_index(const std::string &column_name);
+
+    /**
+     * [column: returns the name of the indexed field]
+     */
+    const std::string &column() const;
+
+    /**
+     * [insert: adds the record <row> with the field value <key>]
+     */
+    void insert(int64_t key, size_t row);
+    void insert(std::string_view key, size_t row);
+
+    /**
+     * [erase: removes the records <row> with the field values <key> given as pairs <key, row>;]
+     * [       the rows of one value are removed in a single pass over its list (sorts <entries>)]
+     */
+    void erase(std::vector<std::pair<int64_t, size_t>> &entries);
+    void erase(std::vector<std::pair<std::string_view, size_t>> &entries);
+
+    /**
+     * [find: appends to <rows> the numbers of the records with the field value <key>]
+     */
+    void find(int64_t key, std::vector<size_t> &rows) const;
+    void find(std::string_view key, std::vector<size_t> &rows) const;
+
+    /**
+     * [clear: removes all records from the index]
+     */
+    void clear();
+
+private:
+    std::string column_name; // индексируемое поле
+    std::unordered_map<int64_t, std::vector<size_t>> long_index;          // для полей LONG
+    std::unordered_map<std::string_view, std::vector<size_t>> text_index; // для полей TEXT: ключи в text_keys
+    String_arena text_keys; // байты значений TEXT
+
+    /**
+     * [pack_keys: copies the values still in use into a new arena (too much garbage in the old one)]
+     */
+    void pack_keys();
+}; // class Hash_index
+
+
+/**
+ * [NB!] упорядоченный индекс (B+-дерево) для полей LONG;
+ *       узлы выровнены по строке кэша и занимают целое число строк кэша,
+ *       при удалении узлы не сливаются: дерево перестраивается при уплотнении таблицы
+ */
+class Btree_index
+{
+public:
+    static const int CAPACITY = 16; // записей в узле: 16 * 16 байт = 4 строки кэша
+
+    /**
+     * [constructor: default]
+     */
+    Btree_index();
+
+    /**
+     * [constructor: creates an empty index on the field <column_name>]
+     */
+    explicit Btree_index(const std::string &column_name);
+
+    /**
+     * [узлы ссылаются друг на друга: копирование запрещено, перемещение сохраняет адреса узлов]
+     */
+    Btree_index(const Btree_index &) = delete;
+    Btree_index &operator=(const Btree_index &) = delete;
+    Btree_index(Btree_index &&) = default;
+    Btree_index &operator=(Btree_index &&) = default;
+
+    /**
+     * [column: returns the name of the indexed field]
+     */
+    const std::string &column() const;
+
+    /**
+     * [insert/erase: adds/removes the record <row> with the field value <key>]
+     */
+    void insert(int64_t key, size_t row);
+    void erase(int64_t key, size_t row);
+
+    /**
+     * [build: fills the index from scratch with the pairs <key, row> (the vector is sorted in place)]
+     */
+    void build(std::vector<std::pair<int64_t, size_t>> &entries);
+
+    /**
+     * [range: appends to <rows> the records with <low> <= key <= <high> in ascending key order]
+     */
+    void range(int64_t low, int64_t high, std::vector<size_t> &rows) const;
+
+    /**
+     * [clear: removes all records from the index]
+     */
+    void clear();
+
+private:
+    class Entry
+    {
+    public:
+        int64_t key; // значение поля
+        size_t row;  // номер строки: делает записи с одинаковыми ключами различимыми
+
+        bool operator<(const Entry &other) const
+        {
+            return key < other.key || (key == other.key && row < other.row);
+        }
+    }; // class Entry
+
+    class Node
+    {
+    public:
+        bool leaf;     // лист или внутренний узел
+        int count = 0; // число записей (ключей) в узле
+    }; // class Node
+
+    class alignas(64) Leaf : public Node
+    {
+    public:
+        Entry entries[CAPACITY]; // записи по возрастанию
+        Leaf *next = nullptr;    // следующий лист: для просмотра диапазона
+    }; // class Leaf
+
+    class alignas(64) Inner : public Node
+    {
+    public:
+        Entry keys[CAPACITY];           // keys[i] -- наименьшая запись поддерева children[i + 1]
+        Node *children[CAPACITY + 1];
+    }; // class Inner
+
+    std::string column_name;  // индексируемое поле
+    Node *root = nullptr;     // корень дерева
+    std::deque<Leaf> leaves;  // память узлов: адреса элементов deque не меняются
+    std::deque<Inner> inners;
+
+    Leaf *new_leaf();
+    Inner *new_inner();
+
+    /**
+     * [insert_into: inserts <entry> into the subtree <node>; if the node splits,]
+     * [             returns true and the new right node <split> with its key   ]
+     */
+    bool insert_into(Node *node, const Entry &entry, Entry &split_key, Node *&split);
+
+    /**
+     * [find_leaf: returns the leaf where <entry> is or should be located]
+     */
+    Leaf *find_leaf(const Entry &entry) const;
+}; // class Btree_index
+
+#endif // SQL_INTERPRETER_INDEX_H
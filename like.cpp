@@ -0,0 +1,147 @@
+#include <cstddef>     // size_t
+#include <cstring>     // memcmp(), memchr(), memmem()
+#include <string>      // std::string: find(), find_first_not_of()
+#include <string_view> // std::string_view
+#include <vector>      // std::vector: push_back(), back()
+
+#include "like.h" // прототипы всех функций, описанных в этом файле
+
+
+/* -------------------- class Like_pattern -------------------- */
+
+Like_pattern::Like_pattern() = default;
+
+
+Like_pattern::Like_pattern(const std::string &pattern)
+{
+    anchored_begin = pattern.empty() || pattern.front() != '%';
+    anchored_end = pattern.empty() || pattern.back() != '%';
+
+    // режем шаблон по '%', подряд идущие '%' равносильны одному
+    size_t begin = 0;
+    while (begin <= pattern.size()) {
+        size_t end = pattern.find('%', begin);
+        if (end == std::string::npos) {
+            end = pattern.size();
+        }
+        if (end != begin) {
+            Segment segment;
+            segment.text = pattern.substr(begin, end - begin);
+            segment.wildcard = segment.text.find('_') != std::string::npos;
+            segment.anchor = segment.text.find_first_not_of('_');
+            min_length += segment.text.size();
+            segments.push_back(segment);
+        }
+        begin = end + 1;
+    }
+
+    if (segments.empty()) {
+        kind = pattern.empty() ? LIKE_EXACT : LIKE_ANY;
+    } else if (segments.size() > 1) {
+        kind = LIKE_GENERAL;
+    } else if (anchored_begin) {
+        kind = anchored_end ? LIKE_EXACT : LIKE_PREFIX;
+    } else {
+        kind = anchored_end ? LIKE_SUFFIX : LIKE_CONTAINS;
+    }
+}
+
+
+bool Like_pattern::match(std::string_view value) const
+{
+    if (value.size() < min_length) {
+        return false;
+    }
+    switch (kind) {
+        case LIKE_EXACT:
+            return value.size() == min_length && (segments.empty() || equal_at(value, 0, segments[0]));
+        case LIKE_PREFIX:
+            return equal_at(value, 0, segments[0]);
+        case LIKE_SUFFIX:
+            return equal_at(value, value.size() - min_length, segments[0]);
+        case LIKE_CONTAINS:
+            return find(value, 0, segments[0]) != std::string_view::npos;
+        case LIKE_ANY:
+            return true;
+        default:
+            return match_general(value);
+    }
+}
+
+
+bool Like_pattern::equal_at(std::string_view value, size_t position, const Segment &segment)
+{
+    const std::string &text = segment.text;
+    if (!segment.wildcard) {
+        return std::memcmp(value.data() + position, text.data(), text.size()) == 0;
+    }
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '_' && text[i] != value[position + i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+size_t Like_pattern::find(std::string_view value, size_t from, const Segment &segment)
+{
+    const std::string &text = segment.text;
+    if (from > value.size() || value.size() - from < text.size()) {
+        return std::string_view::npos;
+    }
+    if (!segment.wildcard) {
+        const void *found = memmem(value.data() + from, value.size() - from, text.data(), text.size());
+        return found == nullptr ? std::string_view::npos : static_cast<const char *>(found) - value.data();
+    }
+    if (segment.anchor == std::string::npos) { // одни '_': подходит любая позиция
+        return from;
+    }
+
+    // ищем memchr'ом первый символ, отличный от '_', и проверяем часть шаблона вокруг него
+    const char key = text[segment.anchor];
+    const size_t last = value.size() - text.size(); // последняя возможная позиция начала
+    for (size_t start = from; start <= last; ++start) {
+        const void *found = std::memchr(value.data() + start + segment.anchor, key, last - start + 1);
+        if (found == nullptr) {
+            return std::string_view::npos;
+        }
+        start = static_cast<const char *>(found) - value.data() - segment.anchor;
+        if (equal_at(value, start, segment)) {
+            return start;
+        }
+    }
+    return std::string_view::npos;
+}
+
+
+bool Like_pattern::match_general(std::string_view value) const
+{
+    size_t first = 0, last = segments.size(); // части, которые ищутся поиском
+    size_t position = 0, end = value.size();  // ещё не сопоставленный участок [position, end)
+
+    if (anchored_begin) {
+        if (!equal_at(value, 0, segments[first])) {
+            return false;
+        }
+        position = segments[first++].text.size();
+    }
+    if (anchored_end) { // длины хватает: value.size() >= min_length
+        const Segment &tail = segments[--last];
+        end -= tail.text.size();
+        if (!equal_at(value, end, tail)) {
+            return false;
+        }
+    }
+
+    // '%' поглощает что угодно, поэтому самое левое вхождение каждой части не хуже любого другого
+    const std::string_view middle = value.substr(0, end);
+    for (size_t i = first; i < last; ++i) {
+        position = find(middle, position, segments[i]);
+        if (position == std::string_view::npos) {
+            return false;
+        }
+        position += segments[i].text.size();
+    }
+    return true;
+}
@@ -0,0 +1,77 @@
+#ifndef SQL_INTERPRETER_LIKE_H
+#define SQL_INTERPRETER_LIKE_H
+
+#include <cstddef>     // size_t
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <vector>      // std::vector
+
+/* ------------------------------------------------ */
+/* --------------------- LIKE --------------------- */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] шаблон LIKE: '%' - любая (в т.ч. пустая) последовательность символов,
+ *       '_' - ровно один символ; остальные символы сравниваются как есть
+ */
+class Like_pattern
+{
+public:
+    /**
+     * [constructor: default, matches only the empty string]
+     */
+    Like_pattern();
+
+    /**
+     * [constructor: compiles the LIKE <pattern>]
+     */
+    explicit Like_pattern(const std::string &pattern);
+
+    /**
+     * [match: returns true if the whole <value> matches the pattern]
+     */
+    bool match(std::string_view value) const;
+
+private:
+    enum like_kind
+    {
+        LIKE_EXACT,    // abc
+        LIKE_PREFIX,   // abc%
+        LIKE_SUFFIX,   // %abc
+        LIKE_CONTAINS, // %abc%
+        LIKE_ANY,      // %
+        LIKE_GENERAL   // a%b%c и т.п.
+    }; // enum like_kind
+
+    class Segment
+    {
+    public:
+        std::string text;       // часть шаблона между '%'
+        bool wildcard = false;  // содержит '_'
+        size_t anchor = 0;      // позиция первого символа, отличного от '_' (npos, если таких нет)
+    }; // class Segment
+
+    like_kind kind = LIKE_EXACT;
+    std::vector<Segment> segments; // части шаблона между '%' по порядку (без пустых)
+    bool anchored_begin = true;    // шаблон не начинается с '%'
+    bool anchored_end = true;      // шаблон не заканчивается на '%'
+    size_t min_length = 0;         // суммарная длина частей: короче строка подойти не может
+
+    /**
+     * [equal_at: returns true if <segment> matches <value> starting at <position>]
+     * [          (<value> must contain at least segment.text.size() characters there)]
+     */
+    static bool equal_at(std::string_view value, size_t position, const Segment &segment);
+
+    /**
+     * [find: returns the first position >= <from> where <segment> occurs in <value>; npos if none]
+     */
+    static size_t find(std::string_view value, size_t from, const Segment &segment);
+
+    /**
+     * [match_general: matches <value> segment by segment, taking the leftmost occurrences]
+     */
+    bool match_general(std::string_view value) const;
+}; // class Like_pattern
+
+#endif // SQL_INTERPRETER_LIKE_H
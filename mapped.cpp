@@ -0,0 +1,52 @@
+#include <cstddef>    // size_t
+#include <string>     // std::string
+#include <stdexcept>  // std::runtime_error
+#include <sys/mman.h> // mmap(), munmap(), madvise()
+#include <sys/stat.h> // fstat()
+#include <fcntl.h>    // open()
+#include <unistd.h>   // close()
+
+#include "mapped.h" // прототипы всех функций, описанных в этом файле
+
+
+/* -------------------- class Mapped_file -------------------- */
+
+Mapped_file::Mapped_file(const std::string &file_name, bool sequential)
+{
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("can't open file " + file_name);
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1) {
+        close(fd);
+        throw std::runtime_error("can't read file " + file_name);
+    }
+    size = info.st_size;
+    if (size != 0) {
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("can't map file " + file_name);
+        }
+        if (sequential) {
+            madvise(mapping, size, MADV_SEQUENTIAL);
+        }
+        begin = static_cast<const char *>(mapping);
+    }
+    close(fd); // отображение остаётся действительным и без дескриптора
+}
+
+
+Mapped_file::~Mapped_file()
+{
+    if (begin != nullptr) {
+        munmap(const_cast<char *>(begin), size);
+    }
+}
+
+
+std::string_view Mapped_file::data() const
+{
+    return std::string_view(begin, size);
+}
@@ -0,0 +1,171 @@
+#ifndef SQL_INTERPRETER_MAPPED_H
+#define SQL_INTERPRETER_MAPPED_H
+
+#include <cstddef>     // size_t
+#include <string>      // std::string
+#include <string_view> // std::string_view
+#include <vector>      // std::vector
+#include <memory>      // std::shared_ptr
+#include <utility>     // std::move()
+
+/* ------------------------------------------------ */
+/* -------------------- MAPPED -------------------- */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] файл отображается в память только для чтения и не копируется: страницы
+ *       подгружаются ядром по мере обращения к ним
+ */
+class Mapped_file
+{
+public:
+    /**
+     * [constructor: maps the file <file_name> into memory (throws std::runtime_error on failure);]
+     * [             <sequential> asks the kernel to read ahead for a front-to-back scan        ]
+     */
+    explicit Mapped_file(const std::string &file_name, bool sequential = false);
+
+    Mapped_file(const Mapped_file &) = delete;
+    Mapped_file &operator=(const Mapped_file &) = delete;
+
+    /**
+     * [destructor: unmaps the file]
+     */
+    ~Mapped_file();
+
+    /**
+     * [data: returns the contents of the file]
+     */
+    std::string_view data() const;
+
+private:
+    const char *begin = nullptr; // начало отображения (nullptr для пустого файла)
+    size_t size = 0;             // длина файла
+}; // class Mapped_file
+
+
+/**
+ * [NB!] массив, который может ссылаться на участок отображённого файла: пока массив только
+ *       читается, он не занимает памяти и не копируется; первое изменение переносит его
+ *       в собственный std::vector
+ */
+template <class T>
+class Mapped_vector
+{
+public:
+    /**
+     * [constructor: default, empty array]
+     */
+    Mapped_vector() = default;
+
+    /**
+     * [constructor: array of <count> elements at <view> inside the mapped <file>]
+     */
+    Mapped_vector(std::shared_ptr<const Mapped_file> file, const T *view, size_t count)
+            : file(std::move(file)), view(view), count(count)
+    {}
+
+    size_t size() const
+    {
+        return file ? count : owned.size();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    size_t capacity() const
+    {
+        return file ? count : owned.capacity();
+    }
+
+    const T *data() const
+    {
+        return file ? view : owned.data();
+    }
+
+    const T &operator[](size_t i) const
+    {
+        return data()[i];
+    }
+
+    const T &back() const
+    {
+        return data()[size() - 1];
+    }
+
+    const T *begin() const
+    {
+        return data();
+    }
+
+    const T *end() const
+    {
+        return data() + size();
+    }
+
+    /**
+     * [set: writes <value> into the element <i>]
+     */
+    void set(size_t i, const T &value)
+    {
+        own();
+        owned[i] = value;
+    }
+
+    void push_back(const T &value)
+    {
+        own();
+        owned.push_back(value);
+    }
+
+    void reserve(size_t capacity)
+    {
+        own();
+        owned.reserve(capacity);
+    }
+
+    void clear()
+    {
+        file.reset();
+        owned.clear();
+    }
+
+    /**
+     * [assign: replaces the elements with <values>]
+     */
+    void assign(std::vector<T> values)
+    {
+        file.reset();
+        owned = std::move(values);
+    }
+
+    /**
+     * [release: empties the array and frees its memory]
+     */
+    void release()
+    {
+        file.reset();
+        std::vector<T>().swap(owned);
+    }
+
+private:
+    std::shared_ptr<const Mapped_file> file; // отображение, на которое ссылается массив (пусто - своя память)
+    const T *view = nullptr;                 // начало массива в отображении
+    size_t count = 0;                        // длина массива в отображении
+    std::vector<T> owned;                    // собственные элементы (если <file> пуст)
+
+    /**
+     * [own: copies the mapped elements into the own memory before the first change]
+     */
+    void own()
+    {
+        if (file) {
+            owned.assign(view, view + count);
+            file.reset();
+        }
+    }
+}; // class Mapped_vector
+
+#endif // SQL_INTERPRETER_MAPPED_H
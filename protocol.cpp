@@ -0,0 +1,169 @@
+#include <cstdint>   // uint8_t, uint32_t, int64_t
+#include <string>    // std::string: append(), assign()
+#include <vector>    // std::vector: push_back(), emplace_back()
+#include <utility>   // std::move()
+#include <stdexcept> // std::length_error
+
+#include "protocol.h" // прототипы всех функций, описанных в этом файле
+
+
+void put_frame(std::string &out, frame_kind kind, const std::string &payload)
+{
+    uint32_t size = payload.size();
+    char header[FRAME_HEADER_SIZE] = {
+            static_cast<char>(size >> 24), static_cast<char>(size >> 16),
+            static_cast<char>(size >> 8), static_cast<char>(size),
+            static_cast<char>(kind)
+    };
+    out.append(header, FRAME_HEADER_SIZE);
+    out.append(payload);
+}
+
+
+bool take_frame(const std::string &in, size_t &offset, frame_kind &kind, std::string &payload)
+{
+    if (in.size() - offset < FRAME_HEADER_SIZE) {
+        return false;
+    }
+    const unsigned char *header = reinterpret_cast<const unsigned char *>(in.data() + offset);
+    uint32_t size = uint32_t(header[0]) << 24 | uint32_t(header[1]) << 16 | uint32_t(header[2]) << 8 | header[3];
+    if (size > MAX_FRAME_SIZE) {
+        throw std::length_error("frame is too long");
+    }
+    if (in.size() - offset - FRAME_HEADER_SIZE < size) {
+        return false; // кадр пришёл не целиком
+    }
+    kind = static_cast<frame_kind>(header[4]);
+    payload.assign(in, offset + FRAME_HEADER_SIZE, size);
+    offset += FRAME_HEADER_SIZE + size;
+    return true;
+}
+
+
+void put_u32(std::string &out, uint32_t value)
+{
+    char bytes[4];
+    for (int i = 0; i < 4; ++i) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    out.append(bytes, 4);
+}
+
+
+void put_i64(std::string &out, int64_t value)
+{
+    uint64_t bits = value;
+    char bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<char>(bits >> (8 * i));
+    }
+    out.append(bytes, 8);
+}
+
+
+/**
+ * [get_u64: reads <size> little-endian bytes of <in> at <offset> and moves <offset> past them]
+ */
+static uint64_t get_u64(const std::string &in, size_t &offset, size_t size)
+{
+    if (in.size() - offset < size) {
+        throw std::length_error("binary result is truncated");
+    }
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(in.data() + offset);
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+        value |= uint64_t(bytes[i]) << (8 * i);
+    }
+    offset += size;
+    return value;
+}
+
+
+/**
+ * [get_string: reads a string of <size> bytes of <in> at <offset> and moves <offset> past it]
+ */
+static std::string get_string(const std::string &in, size_t &offset, size_t size)
+{
+    if (in.size() - offset < size) {
+        throw std::length_error("binary result is truncated");
+    }
+    offset += size;
+    return in.substr(offset - size, size);
+}
+
+
+/* -------------------- class Binary_result -------------------- */
+
+void Binary_result::read(const std::string &payload)
+{
+    size_t offset = 0;
+    if (!has_schema) {
+        if (payload.empty()) {
+            return; // команда ничего не выбирала
+        }
+        table_name = get_string(payload, offset, get_u64(payload, offset, 4));
+        size_t count = get_u64(payload, offset, 4);
+        for (size_t col = 0; col < count; ++col) {
+            Column column;
+            column.type = static_cast<binary_type>(get_u64(payload, offset, 1));
+            if (column.type != BINARY_LONG && column.type != BINARY_TEXT) {
+                throw std::length_error("unknown column type in binary result");
+            }
+            column.name = get_string(payload, offset, get_u64(payload, offset, 4));
+            columns.push_back(std::move(column));
+        }
+        has_schema = true;
+    }
+
+    while (offset < payload.size()) {
+        size_t batch = get_u64(payload, offset, 4);
+        if (batch > BINARY_BATCH) {
+            throw std::length_error("binary batch is too long");
+        }
+        for (auto &column : columns) {
+            if (column.type == BINARY_LONG) {
+                for (size_t i = 0; i < batch; ++i) {
+                    column.longs.push_back(static_cast<int64_t>(get_u64(payload, offset, 8)));
+                }
+                continue;
+            }
+            // TEXT: массив смещений, затем строки подряд
+            size_t offsets = offset;
+            offset += 4 * (batch + 1);
+            if (offset > payload.size()) {
+                throw std::length_error("binary result is truncated");
+            }
+            size_t begin = get_u64(payload, offsets, 4);
+            size_t data = offset;
+            for (size_t i = 0; i < batch; ++i) {
+                size_t end = get_u64(payload, offsets, 4);
+                if (end < begin || data + end > payload.size()) {
+                    throw std::length_error("bad string offset in binary result");
+                }
+                column.texts.emplace_back(payload, data + begin, end - begin);
+                begin = end;
+            }
+            offset = data + begin;
+        }
+        rows += batch;
+    }
+}
+
+
+void Binary_result::clear_rows()
+{
+    for (auto &column : columns) {
+        column.longs.clear();
+        column.texts.clear();
+    }
+    rows = 0;
+}
+
+
+void Binary_result::clear()
+{
+    table_name.clear();
+    columns.clear();
+    rows = 0;
+    has_schema = false;
+}
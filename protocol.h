@@ -0,0 +1,108 @@
+#ifndef SQL_INTERPRETER_PROTOCOL_H
+#define SQL_INTERPRETER_PROTOCOL_H
+
+#include <cstdint> // uint8_t, uint32_t
+#include <cstddef> // size_t
+#include <string>  // std::string
+#include <vector>  // std::vector
+
+/* ------------------------------------------------ */
+/* ------------------- PROTOCOL ------------------- */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] обмен между клиентом и сервером идёт кадрами:
+ *       [длина данных: 4 байта, сетевой порядок][вид кадра: 1 байт][данные]
+ *       клиент может отправить сколько угодно команд подряд, не дожидаясь ответов;
+ *       на каждую команду сервер отвечает, в том же порядке, кадрами FRAME_CHUNK (части
+ *       длинного результата по мере готовности) и одним завершающим FRAME_OK или FRAME_ERROR
+ */
+enum frame_kind : uint8_t
+{
+    /* клиент -> сервер */
+    FRAME_QUERY = 0, // команда SQL
+    FRAME_END   = 1, // завершение сеанса (сервер отвечает FRAME_END и закрывает соединение)
+    FRAME_QUERY_BINARY = 5, // команда SQL, результат которой нужен в двоичном виде
+    /* сервер -> клиент */
+    FRAME_OK    = 2, // команда выполнена, данные - её результат (возможно, пустой)
+    FRAME_ERROR = 3, // команда отвергнута, данные - текст ошибки
+    FRAME_CHUNK = 4  // очередная часть результата, за ней последуют ещё кадры этой же команды
+}; // enum frame_kind
+
+const size_t FRAME_HEADER_SIZE = 5;        // длина + вид кадра
+const uint32_t MAX_FRAME_SIZE = 64u << 20; // кадры длиннее считаются мусором
+
+/**
+ * [NB!] двоичный результат (ответ на FRAME_QUERY_BINARY) -- поток, разрезанный на кадры
+ *       FRAME_CHUNK ... FRAME_OK по границам пачек строк; все числа -- little-endian:
+ *       схема: [u32 длина][имя таблицы][u32 число полей], затем по каждому полю [u8 тип][u32 длина][имя]
+ *       пачка: [u32 число строк], затем по каждому полю по порядку:
+ *              LONG -- значения подряд по 8 байт;
+ *              TEXT -- (число строк + 1) смещений u32 от начала строк поля, затем сами строки подряд
+ *       у команды без выборки данные пустые
+ */
+enum binary_type : uint8_t
+{
+    BINARY_LONG = 0,
+    BINARY_TEXT = 1
+}; // enum binary_type
+
+const size_t BINARY_BATCH = 4096; // наибольшее число строк в пачке
+
+/**
+ * [put_u32/put_i64: append to <out> the <value> in little-endian]
+ */
+void put_u32(std::string &out, uint32_t value);
+void put_i64(std::string &out, int64_t value);
+
+/**
+ * [NB!] разбор двоичного результата на стороне клиента: кадры подаются в read() по порядку,
+ *       строки каждой пачки дописываются в поля <columns>
+ */
+class Binary_result
+{
+public:
+    class Column
+    {
+    public:
+        std::string name;               // имя поля
+        binary_type type;               // тип поля
+        std::vector<int64_t> longs;     // значения поля LONG
+        std::vector<std::string> texts; // значения поля TEXT
+    }; // class Column
+
+    std::string table_name;       // таблица, из которой сделана выборка
+    std::vector<Column> columns;  // выбранные поля
+    size_t rows = 0;              // сколько строк сейчас лежит в <columns>
+    bool has_schema = false;      // схема уже прочитана
+
+    /**
+     * [read: decodes the next frame <payload> of the result and appends its rows to <columns>]
+     * [      (throws std::length_error if the data is malformed)                             ]
+     */
+    void read(const std::string &payload);
+
+    /**
+     * [clear_rows: drops the decoded rows, keeping the schema]
+     */
+    void clear_rows();
+
+    /**
+     * [clear: forgets the schema and the rows before the next result]
+     */
+    void clear();
+}; // class Binary_result
+
+/**
+ * [put_frame: appends to <out> the frame of <kind> with <payload>]
+ */
+void put_frame(std::string &out, frame_kind kind, const std::string &payload);
+
+/**
+ * [take_frame: if <in> holds a complete frame starting at <offset>, extracts its <kind> and]
+ * [            <payload>, moves <offset> past it and returns true; returns false otherwise]
+ * [            (throws std::length_error if the frame is longer than MAX_FRAME_SIZE)     ]
+ */
+bool take_frame(const std::string &in, size_t &offset, frame_kind &kind, std::string &payload);
+
+#endif // SQL_INTERPRETER_PROTOCOL_H
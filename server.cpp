@@ -2,97 +2,631 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <netdb.h>
 #include <arpa/inet.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <string.h>
+#include <stdint.h>
 #include <string>
-//#include "analyze.h"    // Analyze: start()
+#include <deque>
+#include <map>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <stdexcept>
+#include <tuple>
+#include <chrono>
+#include <cstdlib>
+#include "analyze.h"     // Analyze: start(), get_table_view(), release()
+#include "thread_pool.h" // Thread_pool: submit()
+#include "protocol.h"    // put_frame(), take_frame()
+#include "storage.h"     // open_database()
+#include "wal.h"         // wal: open(), wait()
+#include "csv.h"         // import_directory
 
-using namespace std; 
+using namespace std;
+
+const int PORT = 54000;        // порт сервера
+const int MAX_EVENTS = 64;     // сколько событий epoll разбираем за один вызов
+const size_t BUF_SIZE = 65536; // сколько байт забираем из сокета за один recv
+const size_t CHUNK_SIZE = 65536;      // по сколько байт результат уходит клиенту
+const size_t HIGH_WATER = 1u << 20;   // сколько неотправленных байт может накопить рабочий поток
+const auto STALL_TIMEOUT = chrono::milliseconds(200); // сколько выборка ждёт клиента, не читающего ответ
+const size_t STALL_LIMIT = 64u << 20;  // сколько байт выборки копируется в память для такого клиента
+
+
+// рабочий поток сообщает сетевому: у клиента <fd> есть новые данные (<finished>: пачка команд исполнена)
+static void notify(int fd, bool finished);
+
+
+/**
+ * [NB!] ответы рабочего потока идут клиенту через Outbox по частям: пока клиент не забрал
+ *       HIGH_WATER байт, поток ждёт, поэтому память под результат не растёт с его размером;
+ *       таблица результата всё это время заблокирована на чтение, поэтому клиента, который
+ *       не читает ответ дольше STALL_TIMEOUT, больше не ждём: остаток выборки копируется
+ *       в память Outbox, и таблица с рабочим потоком освобождаются; если неотправленных байт
+ *       набирается больше STALL_LIMIT, выборка обрывается ошибкой
+ */
+class Outbox
+{
+public:
+    explicit Outbox(int fd) : fd(fd)
+    {}
+
+    /**
+     * [push: queues the frame of <kind> with <payload> for sending (dropped if the client is gone)]
+     */
+    void push(frame_kind kind, const string &payload)
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            if (cancelled) {
+                return;
+            }
+            size_t size = data.size();
+            put_frame(data, kind, payload);
+            in_flight += data.size() - size;
+        }
+        notify(fd, false);
+    }
+
+    /**
+     * [wait_for: blocks the worker while more than HIGH_WATER bytes are not sent yet, but at most]
+     * [          <timeout>; returns false if the client still has not taken them                ]
+     */
+    template <class Duration>
+    bool wait_for(Duration timeout)
+    {
+        unique_lock<mutex> guard(lock);
+        return drained.wait_for(guard, timeout, [this] { return cancelled || in_flight <= HIGH_WATER; });
+    }
+
+    /**
+     * [queued: returns how many bytes are not sent yet]
+     */
+    size_t queued()
+    {
+        lock_guard<mutex> guard(lock);
+        return in_flight;
+    }
+
+    /**
+     * [take: moves the queued frames to the end of <out>, returns their size (network thread)]
+     */
+    size_t take(string &out)
+    {
+        lock_guard<mutex> guard(lock);
+        size_t size = data.size();
+        out += data;
+        data.clear();
+        return size;
+    }
+
+    /**
+     * [sent: <bytes> of the taken frames went to the socket (network thread)]
+     */
+    void sent(size_t bytes)
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            in_flight -= bytes;
+        }
+        drained.notify_one();
+    }
+
+    /**
+     * [cancel: the client is gone: wakes the worker and drops the rest of the answers]
+     */
+    void cancel()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            cancelled = true;
+            data.clear();
+        }
+        drained.notify_one();
+    }
+
+private:
+    const int fd;             // дескриптор клиента
+    mutex lock;
+    condition_variable drained;
+    string data;              // кадры, ещё не забранные сетевым потоком
+    size_t in_flight = 0;     // байты, поставленные в очередь, но ещё не ушедшие в сокет
+    bool cancelled = false;
+};
+
+/**
+ * [NB!] ответ на изменение уходит клиенту только после того, как запись журнала о нём
+ *       попала на диск; пока ответ ждёт, исполняются следующие команды пачки, и их записи
+ *       успевают в тот же fsync; ответы, пришедшие следом, ждут вместе с ним, чтобы не
+ *       нарушить порядок
+ */
+class Commit_queue
+{
+public:
+    /**
+     * [reply: sends the frame of <kind> with <payload> once the log record <lsn> is durable]
+     */
+    void reply(Outbox &outbox, uint64_t lsn, frame_kind kind, const string &payload)
+    {
+        if (lsn == 0 && held.empty()) {
+            outbox.push(kind, payload);
+            return;
+        }
+        last_lsn = max(last_lsn, lsn);
+        held.emplace_back(kind, payload);
+    }
+
+    /**
+     * [flush: waits for the log and sends all held answers]
+     */
+    void flush(Outbox &outbox)
+    {
+        wal.wait(last_lsn);
+        for (const auto &frame : held) {
+            outbox.push(frame.first, frame.second);
+        }
+        held.clear();
+        last_lsn = 0;
+    }
+
+    /**
+     * [finish: sends the held answers and reports the batch of the client <fd> as finished once]
+     * [        the log is durable; the worker does not wait for the disk and takes other tasks ]
+     */
+    void finish(Outbox &outbox, int fd)
+    {
+        wal.when_durable(last_lsn, [&outbox, fd, held = std::move(held)]() {
+            for (const auto &frame : held) {
+                outbox.push(frame.first, frame.second);
+            }
+            notify(fd, true); // до этого следующая пачка клиента не начнётся: порядок ответов сохранён
+        });
+        held.clear();
+        last_lsn = 0;
+    }
+
+private:
+    uint64_t last_lsn = 0;                   // последняя запись журнала, которую ждут ответы
+    vector<pair<frame_kind, string>> held;   // ответы, ждущие журнала
+};
+
+// состояние соединения с клиентом
+class Connection
+{
+public:
+    Connection(int key, int fd) : session(key), outbox(fd)
+    {}
+
+    Analyze session;    // свой анализатор у каждого клиента: буферы переиспользуются между командами
+    Outbox outbox;      // ответы рабочего потока, ещё не забранные сетевым
+    string in;          // принятые, но ещё не разобранные байты (растёт под длинную команду)
+    deque<pair<frame_kind, string>> pending; // принятые кадры, ждущие исполнения
+    string out;         // ответы, ещё не отправленные клиенту
+    size_t sent = 0;    // сколько байт <out> уже отправлено
+    size_t owed = 0;    // сколько байт в начале неотправленной части <out> пришло из <outbox>
+    bool busy = false;    // команда клиента сейчас исполняется рабочим потоком
+    bool closing = false; // закрыть соединение, как только <out> уйдёт
+    bool gone = false;    // клиент отключился, ждём окончания его команды
+    bool writing = false; // подписаны ли мы на EPOLLOUT
+};
+
+
+// уведомления рабочих потоков: <дескриптор клиента, исполнена ли пачка его команд>
+static mutex done_mutex;
+static vector<pair<int, bool>> done;
+static int done_event; // eventfd: будит сетевой поток, когда в <done> что-то появилось
+
+
+static void notify(int fd, bool finished)
+{
+    {
+        lock_guard<mutex> guard(done_mutex);
+        done.emplace_back(fd, finished);
+    }
+    uint64_t one = 1;
+    ssize_t written = write(done_event, &one, sizeof(one));
+    (void) written;
+}
 
-int main(){
-	//создаем сокет
-    cout<< "Waiting for client";
 
+/**
+ * [set_nonblocking: switches the descriptor <fd> to non-blocking mode]
+ */
+static bool set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+
+/**
+ * [execute: runs the <query> in the <session> and streams its answer to the <outbox>]
+ * [         as text or, if <binary>, in the binary format of protocol.h; answers to ]
+ * [         changes wait in the <commits> for the log                               ]
+ */
+static void execute(Analyze &session, Outbox &outbox, Commit_queue &commits, const string &query, bool binary)
+{
+    if (query.find_first_not_of(" \t\r\n") == string::npos) { // пустой запрос до анализатора не доходит
+        commits.reply(outbox, 0, FRAME_ERROR, "!!!LEXICAL ERROR: empty query\n");
+        return;
+    }
+    try {
+        session.start(query); // анализируем и выполняем команду
+    }
+    catch (exception &error) {
+        commits.reply(outbox, 0, FRAME_ERROR, error.what());
+        return;
+    }
+    // результат выводится построчно частями по CHUNK_SIZE: первые строки уходят клиенту сразу
+    string chunk;
+    const Table_view *view = session.get_table_view();
+    if (view == nullptr) {
+        uint64_t lsn = session.get_commit_lsn();
+        session.release(); // пока журнал сбрасывается на диск, таблица уже свободна
+        commits.reply(outbox, lsn, FRAME_OK, chunk);
+        return;
+    }
+    commits.flush(outbox); // выборка уходит клиенту сразу, значит и все ответы перед ней
+    size_t row = 0;
+    if (binary)
+        view->schema(chunk);
+    else
+        view->header(chunk);
+    bool stalled = false; // клиент не читает ответ: остаток выборки копируется, не дожидаясь его
+    try {
+        while ((row = binary? view->write_batches(chunk, row, CHUNK_SIZE):
+                              view->write_rows(chunk, row, CHUNK_SIZE)) < view->size()) {
+            outbox.push(FRAME_CHUNK, chunk);
+            chunk.clear();
+            if (!stalled) {
+                stalled = !outbox.wait_for(STALL_TIMEOUT); // ждём, пока клиент заберёт уже готовое
+            } else if (outbox.queued() > STALL_LIMIT) { // память под чужой ответ не растёт без предела
+                throw runtime_error("the client does not read the result");
+            }
+        }
+        outbox.push(FRAME_OK, chunk);
+    }
+    catch (exception &error) { // строка не помещается в кадр или клиент не читает: ответ обрывается ошибкой
+        outbox.push(FRAME_ERROR, string("!!!RUN TIME ERROR: ") + error.what() + "\n");
+    }
+    session.release(); // результат прочитан: таблицу можно отдавать другим клиентам
+}
+
+
+/**
+ * [watch: subscribes to EPOLLOUT for <fd> while <conn> has unsent data]
+ */
+static void watch(int epoll, int fd, Connection &conn, bool writing)
+{
+    if (conn.writing == writing) {
+        return;
+    }
+    epoll_event event;
+    event.events = EPOLLIN | (writing ? uint32_t(EPOLLOUT) : 0u);
+    event.data.fd = fd;
+    epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &event);
+    conn.writing = writing;
+}
+
+
+/**
+ * [flush: sends as much of the pending output as the socket accepts;]
+ * [       returns false if the connection must be closed              ]
+ */
+static bool flush(int epoll, int fd, Connection &conn)
+{
+    while (conn.sent < conn.out.size()) {
+        ssize_t bytes = send(fd, conn.out.data() + conn.sent, conn.out.size() - conn.sent, MSG_NOSIGNAL);
+        if (bytes == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                watch(epoll, fd, conn, true); // допишем, когда сокет освободится
+                return true;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        conn.sent += bytes;
+        if (conn.owed != 0) { // ушедшие байты рабочего потока освобождают ему место
+            size_t drained = min<size_t>(bytes, conn.owed);
+            conn.owed -= drained;
+            conn.outbox.sent(drained);
+        }
+    }
+    conn.out.clear();
+    conn.sent = 0;
+    watch(epoll, fd, conn, false);
+    return !conn.closing;
+}
+
+
+/**
+ * [dispatch: hands the queued commands of <conn> to the <pool> as one task; commands of]
+ * [          one client run one batch at a time, so its answers come back in order     ]
+ */
+static void dispatch(Thread_pool &pool, int fd, Connection &conn)
+{
+    if (conn.busy || conn.closing || conn.pending.empty()) {
+        return;
+    }
+    // команды, пришедшие одной пачкой, исполняются подряд одним рабочим потоком
+    vector<pair<string, bool>> queries; // <команда, нужен ли двоичный результат>
+    while (!conn.pending.empty() && (conn.pending.front().first == FRAME_QUERY ||
+                                     conn.pending.front().first == FRAME_QUERY_BINARY)) {
+        queries.emplace_back(std::move(conn.pending.front().second),
+                             conn.pending.front().first == FRAME_QUERY_BINARY);
+        conn.pending.pop_front();
+    }
+    if (queries.empty()) { // FRAME_END и неизвестные кадры завершают сеанс
+        conn.pending.clear();
+        put_frame(conn.out, FRAME_END, "");
+        conn.closing = true;
+        return;
+    }
+
+    conn.busy = true;
+    Analyze &session = conn.session; // пока команды исполняются, сетевой поток сеанс не трогает
+    Outbox &outbox = conn.outbox;
+    pool.submit([fd, &session, &outbox, queries]() {
+        Commit_queue commits; // изменения всей пачки ждут журнала вместе
+        for (const auto &query : queries) {
+            execute(session, outbox, commits, query.first, query.second);
+        }
+        commits.finish(outbox, fd);
+    });
+}
+
+
+/**
+ * [receive: reads everything available from <fd> and queues complete statements;]
+ * [         returns false if the connection must be closed                        ]
+ */
+static bool receive(int fd, Connection &conn)
+{
+    static char buf[BUF_SIZE]; // буфер только сетевого потока, на стеке его не держим
+    while (true) {
+        ssize_t bytes = recv(fd, buf, BUF_SIZE, 0);
+        if (bytes == 0) {
+            return false; // клиент отключился
+        }
+        if (bytes == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            cerr << "Error in recv()" << endl;
+            return false;
+        }
+        conn.in.append(buf, bytes);
+    }
+
+    // разбираем все пришедшие целиком кадры; хвост недошедшего кадра остаётся в <in>
+    size_t offset = 0;
+    frame_kind kind;
+    string payload;
+    try {
+        while (take_frame(conn.in, offset, kind, payload)) {
+            conn.pending.emplace_back(kind, std::move(payload));
+        }
+    }
+    catch (length_error &error) {
+        cerr << "Error in frame: " << error.what() << endl;
+        return false;
+    }
+    conn.in.erase(0, offset);
+    return true;
+}
+
+
+/**
+ * [disconnect: closes the connection <fd>; if its command is still running,]
+ * [            the descriptor is closed when the command finishes          ]
+ */
+static void disconnect(int epoll, int fd, map<int, Connection> &connections)
+{
+    Connection &conn = connections.at(fd);
+    if (!conn.gone) {
+        cout << "Client disconnected " << endl;
+        epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+        conn.gone = true;
+        conn.outbox.cancel(); // рабочий поток мог ждать, пока клиент заберёт результат
+    }
+    if (!conn.busy) {
+        // Закрываем сокет
+        close(fd);
+        connections.erase(fd);
+    }
+}
+
+
+int main(int argc, char *argv[]){
+	//создаем сокет
 	int listening = socket(AF_INET, SOCK_STREAM, 0);
 	if (listening == -1)
     {
         cerr << "Can't create a socket! Quitting" << endl;
         return -1;
     }
+    int reuse = 1;
+    setsockopt(listening, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
     //создаем ip адрес и порт для сокета
     sockaddr_in hint;
     hint.sin_family = AF_INET;
-    hint.sin_port = htons(54000);
-    
-    inet_pton(AF_INET, "0.0.0.0", &hint.sin_addr);
-
-    bind(listening, (sockaddr*)&hint, sizeof(hint));
-    
-    listen(listening, SOMAXCONN);
- 	// ждем соединения 
-
- 	sockaddr_in client;
- 	socklen_t clientSize = sizeof(client);
+    hint.sin_port = htons(PORT);
 
- 	int clientSocket = accept(listening, (sockaddr*)&client, &clientSize);
-
- 	char host[NI_MAXHOST];      
-    char service[NI_MAXSERV];   
-
-    memset(host, 0, NI_MAXHOST); 
-    memset(service, 0, NI_MAXSERV);
+    inet_pton(AF_INET, "0.0.0.0", &hint.sin_addr);
 
-    if (getnameinfo((sockaddr*)&client, sizeof(client), host, NI_MAXHOST, service, NI_MAXSERV, 0) == 0)
+    if (bind(listening, (sockaddr*)&hint, sizeof(hint)) == -1 ||
+        listen(listening, SOMAXCONN) == -1 || !set_nonblocking(listening))
     {
-        cout << host << " connected on port " << service << endl;
+        cerr << "Can't listen on port " << PORT << "! Quitting" << endl;
+        return -1;
     }
-    else
+
+    int epoll = epoll_create1(0);
+    done_event = eventfd(0, EFD_NONBLOCK);
+    if (epoll == -1 || done_event == -1)
     {
-        inet_ntop(AF_INET, &client.sin_addr, host, NI_MAXHOST);
-        cout << host << " connected on port " << ntohs(client.sin_port) << endl;
+        cerr << "Can't create epoll! Quitting" << endl;
+        return -1;
     }
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = listening;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listening, &event);
+    event.data.fd = done_event;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, done_event, &event);
 
-     // Закрываем сокет 
-    close(listening);
+    // команды исполняются рабочими потоками, сетевой поток только принимает и отправляет данные
+    size_t threads = thread::hardware_concurrency();
+    Thread_pool pool(threads != 0 ? threads : 4);
 
-    
-    //Принимаем и отправляем сообщение клиенту 
+    // все клиенты работают с одними таблицами: ключ доступа -- слушающий сокет
+    const int key = listening;
+    // таблицы последней контрольной точки (каталог -- первый аргумент, по умолчанию data)
+    // и журнал после неё; журнал сбрасывается на диск раз в argv[2] мс (по умолчанию 2)
+    // или как только в нём накопится argv[3] КиБ (по умолчанию 1024);
+    // COPY читает файлы только из каталога argv[4] (по умолчанию <каталог>/import)
+    const string directory = argc > 1 ? argv[1] : "data";
+    const chrono::microseconds interval(static_cast<long long>((argc > 2 ? atof(argv[2]) : 2) * 1000));
+    const size_t flush_size = (argc > 3 ? strtoul(argv[3], nullptr, 10) : 1024) << 10;
+    import_directory = argc > 4 ? argv[4] : directory + "/import";
+    try {
+        uint64_t lsn = open_database(key, directory);
+        Analyze replay(key);
+        wal.open(directory + "/wal", lsn, [&replay](string_view command, string_view data) {
+            try {
+                replay.replay(command, data);
+            }
+            catch (exception &error) { // в журнале только выполненные команды: иначе база разошлась бы с ним
+                throw runtime_error(string("can't replay the log: ") + error.what());
+            }
+        }, interval, flush_size);
+    }
+    catch (exception &error) {
+        cerr << "Can't open database in " << directory << ": " << error.what() << "! Quitting" << endl;
+        return -1;
+    }
+    map<int, Connection> connections;
+    epoll_event events[MAX_EVENTS];
 
-    char buf[4096];
- 
+    cout << "Waiting for clients" << endl;
     while (true)
     {
-        memset(buf, 0, 4096);
- 
-        
-        // Ждем отправки данных клиента
-        int bytesReceived = recv(clientSocket, buf, 4096, 0);
-        if (bytesReceived == -1)
+        int ready = epoll_wait(epoll, events, MAX_EVENTS, -1);
+        if (ready == -1)
         {
-            cerr << "Error in recv(). Quitting" << endl;
+            if (errno == EINTR)
+                continue;
+            cerr << "Error in epoll_wait(). Quitting" << endl;
             break;
         }
-        // Analyze analyze = Analyze(listening, buf); // анализируем и выполняем команды
-        // analyze.start();
 
- 
-        if (bytesReceived == 0)
+        for (int i = 0; i < ready; ++i)
         {
-            cout << "Client disconnected " << endl;
-            break;
+            int fd = events[i].data.fd;
+
+            if (fd == listening)
+            {
+                // принимаем всех ожидающих клиентов
+                sockaddr_in client;
+                socklen_t clientSize = sizeof(client);
+                int clientSocket;
+                while ((clientSocket = accept(listening, (sockaddr*)&client, &clientSize)) != -1)
+                {
+                    if (!set_nonblocking(clientSocket))
+                    {
+                        close(clientSocket);
+                        continue;
+                    }
+                    char host[NI_MAXHOST];
+                    inet_ntop(AF_INET, &client.sin_addr, host, NI_MAXHOST);
+                    cout << host << " connected on port " << ntohs(client.sin_port) << endl;
+
+                    epoll_event client_event;
+                    client_event.events = EPOLLIN;
+                    client_event.data.fd = clientSocket;
+                    epoll_ctl(epoll, EPOLL_CTL_ADD, clientSocket, &client_event);
+                    connections.emplace(piecewise_construct, forward_as_tuple(clientSocket),
+                                        forward_as_tuple(key, clientSocket));
+                    clientSize = sizeof(client);
+                }
+                continue;
+            }
+
+            if (fd == done_event)
+            {
+                // забираем готовые ответы рабочих потоков
+                uint64_t count;
+                ssize_t bytes = read(done_event, &count, sizeof(count));
+                (void) bytes;
+                vector<pair<int, bool>> results;
+                {
+                    lock_guard<mutex> guard(done_mutex);
+                    results.swap(done);
+                }
+                for (auto &result : results)
+                {
+                    // пока пачка команд исполняется, соединение не удаляется
+                    auto conn_it = connections.find(result.first);
+                    if (conn_it == connections.end())
+                        continue;
+                    Connection &conn = conn_it->second;
+                    if (result.second)
+                        conn.busy = false;
+                    if (conn.gone)
+                    {
+                        if (!conn.busy)
+                            disconnect(epoll, result.first, connections);
+                        continue;
+                    }
+                    // отправленное начало <out> больше не нужно: буфер не растёт при потоковой выдаче
+                    conn.out.erase(0, conn.sent);
+                    conn.sent = 0;
+                    conn.owed += conn.outbox.take(conn.out);
+                    if (result.second)
+                        dispatch(pool, result.first, conn);
+                    if (!flush(epoll, result.first, conn))
+                        disconnect(epoll, result.first, connections);
+                }
+                continue;
+            }
+
+            auto conn_it = connections.find(fd);
+            if (conn_it == connections.end() || conn_it->second.gone)
+                continue; // соединение закрыто раньше в этом же цикле
+            Connection &conn = conn_it->second;
+            bool alive = true;
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+                alive = false;
+            if (alive && (events[i].events & EPOLLIN))
+            {
+                alive = receive(fd, conn);
+                dispatch(pool, fd, conn);
+            }
+            if (alive || !conn.out.empty())
+                alive = flush(epoll, fd, conn) && alive;
+
+            if (!alive)
+                disconnect(epoll, fd, connections);
         }
- 
-        //cout << string(buf, 0, bytesReceived) << endl;
- 
-        // Отправляем сообщение обратно клиенту
-        send(clientSocket, buf, bytesReceived + 1, 0);
-    }
- 
-    // Закрываем сокет
-    close(clientSocket);
- 
-    return 0;
-}
+    }
 
+    close(done_event);
+    close(epoll);
+    close(listening);
 
+    return 0;
+}
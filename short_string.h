@@ -0,0 +1,144 @@
+#ifndef SQL_INTERPRETER_SHORT_STRING_H
+#define SQL_INTERPRETER_SHORT_STRING_H
+
+#include <cstdint>     // uint32_t
+#include <cstddef>     // size_t
+#include <cstring>     // memcpy(), memcmp()
+#include <string_view> // std::string_view
+
+/* ------------------------------------------------ */
+/* ----------------- SHORT STRING ----------------- */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] значение TEXT в 16 байтах: [u32 длина][12 байт]; строка до 12 байт лежит прямо
+ *       в этих байтах (дополненная нулями), у длинной там первые 4 байта и указатель
+ *       на всю строку (её байты хранит вызывающий: арена поля, файл таблицы, константа);
+ *       длина и первые 4 байта сравниваются одним 8-байтным сравнением, поэтому почти все
+ *       неравные строки различаются, не обращаясь к их байтам в памяти
+ */
+class Short_string
+{
+public:
+    static constexpr size_t INLINE_SIZE = 12; // строки не длиннее хранятся внутри
+
+    Short_string() = default;
+
+    /**
+     * [constructor: copies a short <value>, refers to a long one (it must outlive the object)]
+     */
+    explicit Short_string(std::string_view value) : length(value.size())
+    {
+        if (length <= INLINE_SIZE) {
+            memcpy(bytes, value.data(), length);
+        } else {
+            const char *pointer = value.data();
+            memcpy(bytes, pointer, PREFIX_SIZE);
+            memcpy(bytes + PREFIX_SIZE, &pointer, sizeof(pointer));
+        }
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    bool is_inline() const
+    {
+        return length <= INLINE_SIZE;
+    }
+
+    const char *data() const
+    {
+        if (is_inline()) {
+            return bytes;
+        }
+        const char *pointer;
+        memcpy(&pointer, bytes + PREFIX_SIZE, sizeof(pointer));
+        return pointer;
+    }
+
+    std::string_view view() const
+    {
+        return std::string_view(data(), length);
+    }
+
+    /**
+     * [compare: returns <0, 0 or >0 like std::string_view::compare()]
+     */
+    int compare(const Short_string &other) const
+    {
+        // недостающие байты короткой строки - нули, поэтому различие префиксов уже решает порядок
+        const uint32_t left = prefix(), right = other.prefix();
+        if (left != right) {
+            return left < right ? -1 : 1;
+        }
+        const size_t common = length < other.length ? length : other.length;
+        if (common > PREFIX_SIZE) {
+            int result = memcmp(data() + PREFIX_SIZE, other.data() + PREFIX_SIZE, common - PREFIX_SIZE);
+            if (result != 0) {
+                return result;
+            }
+        }
+        return length < other.length ? -1 : length > other.length;
+    }
+
+    friend bool operator==(const Short_string &left, const Short_string &right)
+    {
+        if (memcmp(&left, &right, sizeof(uint32_t) + PREFIX_SIZE) != 0) { // длина и префикс
+            return false;
+        }
+        if (left.is_inline()) {
+            return memcmp(left.bytes + PREFIX_SIZE, right.bytes + PREFIX_SIZE, INLINE_SIZE - PREFIX_SIZE) == 0;
+        }
+        return memcmp(left.data() + PREFIX_SIZE, right.data() + PREFIX_SIZE, left.length - PREFIX_SIZE) == 0;
+    }
+
+    friend bool operator!=(const Short_string &left, const Short_string &right)
+    {
+        return !(left == right);
+    }
+
+    friend bool operator<(const Short_string &left, const Short_string &right)
+    {
+        return left.compare(right) < 0;
+    }
+
+    friend bool operator>(const Short_string &left, const Short_string &right)
+    {
+        return left.compare(right) > 0;
+    }
+
+    friend bool operator<=(const Short_string &left, const Short_string &right)
+    {
+        return left.compare(right) <= 0;
+    }
+
+    friend bool operator>=(const Short_string &left, const Short_string &right)
+    {
+        return left.compare(right) >= 0;
+    }
+
+private:
+    static constexpr size_t PREFIX_SIZE = 4;
+
+    /**
+     * [prefix: returns the first 4 bytes as a number ordered like the bytes themselves]
+     */
+    uint32_t prefix() const
+    {
+        uint32_t value;
+        memcpy(&value, bytes, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        value = __builtin_bswap32(value);
+#endif
+        return value;
+    }
+
+    uint32_t length = 0;
+    char bytes[INLINE_SIZE] = {}; // вся короткая строка или префикс и указатель длинной
+}; // class Short_string
+
+static_assert(sizeof(Short_string) == 16, "Short_string must stay 16 bytes");
+
+#endif // SQL_INTERPRETER_SHORT_STRING_H
@@ -0,0 +1,776 @@
+#include <cstddef>      // size_t
+#include <cstdint>      // uint8_t, uint32_t, uint64_t, int64_t
+#include <cstring>      // memcpy(), memcmp()
+#include <cstdlib>      // std::strtoull()
+#include <string>       // std::string: append(), substr()
+#include <string_view>  // std::string_view
+#include <vector>       // std::vector
+#include <deque>        // std::deque
+#include <utility>      // std::pair
+#include <memory>       // std::shared_ptr, std::make_shared()
+#include <stdexcept>    // std::runtime_error
+#include <filesystem>   // std::filesystem: create_directories(), directory_iterator, rename(), remove()
+#include <fstream>      // std::ifstream
+#include <iostream>     // std::cout, std::cerr, std::endl
+#include <algorithm>    // std::max(), std::binary_search()
+#include <chrono>       // std::chrono::steady_clock
+#include <mutex>        // std::mutex, std::lock_guard
+#include <thread>       // std::thread
+#include <cerrno>       // errno
+#include <sys/wait.h>   // waitpid()
+#include <fcntl.h>      // open()
+#include <unistd.h>     // write(), read(), fsync(), close(), pipe(), fork(), dup2(), close_range()
+
+#include "storage.h" // прототипы всех функций, описанных в этом файле
+#include "mapped.h"  // Mapped_file, Mapped_vector
+#include "wal.h"     // wal: rotate(), remove_segments()
+
+
+const char TABLE_MAGIC[8] = {'S', 'Q', 'L', 'T', 'A', 'B', '0', '1'}; // начало и конец файла таблицы
+const char *const TABLE_SUFFIX = ".tbl";       // расширение файла таблицы
+const size_t WRITE_BUFFER_SIZE = 1u << 20;     // сколько байт копим перед write()
+
+const char *const CURRENT_FILE = "CURRENT";    // поколение последней контрольной точки и её LSN
+
+static std::string data_directory = "data";    // каталог файлов таблиц (см. open_database)
+static uint64_t current_generation = 0;        // поколение файлов последней контрольной точки
+static std::mutex checkpoint_mutex;            // охраняет <current_generation> и <checkpoint_running>
+static bool checkpoint_running = false;        // фоновая контрольная точка ещё пишется
+
+// как хранится поле
+enum column_encoding : uint8_t
+{
+    ENCODING_LONG = 0,       // значения LONG и min/max блоков (несжатые, только для чтения старых файлов)
+    ENCODING_DICTIONARY = 1, // коды значений TEXT и словарь
+    ENCODING_STRINGS = 2,    // строки TEXT без словаря
+    ENCODING_BLOCKS = 3      // сжатые блоки LONG и min/max блоков
+};
+
+const size_t BLOCK_HEADER_SIZE = 32; // заголовок сжатого блока LONG в файле (см. put_blocks)
+
+// вид индекса в описании таблицы
+enum index_kind : uint8_t
+{
+    INDEX_HASH = 0,
+    INDEX_BTREE = 1
+};
+
+
+/**
+ * [put: appends to <out> the bytes of the <value>]
+ */
+template <class T>
+static void put(std::string &out, T value)
+{
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/**
+ * [put_string: appends to <out> the length of the <value> and the <value> itself]
+ */
+static void put_string(std::string &out, std::string_view value)
+{
+    put<uint32_t>(out, value.size());
+    out.append(value);
+}
+
+
+/**
+ * [NB!] запись файла таблицы: данные копятся в буфере и уходят в файл большими кусками
+ */
+class File_writer
+{
+public:
+    explicit File_writer(const std::string &file_name) : file_name(file_name)
+    {
+        fd = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+            throw std::runtime_error("can't create file " + file_name);
+        }
+    }
+
+    File_writer(const File_writer &) = delete;
+    File_writer &operator=(const File_writer &) = delete;
+
+    ~File_writer()
+    {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+
+    /**
+     * [write: appends <size> bytes at <data> to the file]
+     */
+    void write(const void *data, size_t size)
+    {
+        buffer.append(static_cast<const char *>(data), size);
+        position += size;
+        if (buffer.size() >= WRITE_BUFFER_SIZE) {
+            flush();
+        }
+    }
+
+    /**
+     * [align: pads the file with zeros up to a multiple of 8 bytes]
+     */
+    void align()
+    {
+        static const char zeros[8] = {};
+        write(zeros, (8 - position % 8) % 8);
+    }
+
+    /**
+     * [finish: writes out the rest of the buffer and waits until the file reaches the disk]
+     */
+    void finish()
+    {
+        flush();
+        if (fsync(fd) == -1 || close(fd) == -1) {
+            fd = -1;
+            throw std::runtime_error("can't write file " + file_name);
+        }
+        fd = -1;
+    }
+
+    uint64_t position = 0; // сколько байт уже записано (вместе с буфером)
+
+private:
+    std::string file_name;
+    int fd;
+    std::string buffer;
+
+    void flush()
+    {
+        size_t done = 0;
+        while (done < buffer.size()) {
+            ssize_t bytes = ::write(fd, buffer.data() + done, buffer.size() - done);
+            if (bytes == -1) {
+                throw std::runtime_error("can't write file " + file_name);
+            }
+            done += bytes;
+        }
+        buffer.clear();
+    }
+}; // class File_writer
+
+
+/**
+ * [NB!] чтение описания таблицы с проверкой границ: испорченный файл не должен
+ *       приводить к чтению за пределами отображения
+ */
+class File_reader
+{
+public:
+    File_reader(std::string_view data, const std::string &file_name) : data(data), file_name(file_name)
+    {}
+
+    template <class T>
+    T get()
+    {
+        T value;
+        memcpy(&value, bytes(sizeof(value)).data(), sizeof(value));
+        return value;
+    }
+
+    std::string get_string()
+    {
+        uint32_t size = get<uint32_t>();
+        return std::string(bytes(size));
+    }
+
+    std::string_view bytes(size_t size)
+    {
+        if (data.size() - pos < size) {
+            damaged();
+        }
+        pos += size;
+        return data.substr(pos - size, size);
+    }
+
+    [[noreturn]] void damaged() const
+    {
+        throw std::runtime_error("table file " + file_name + " is damaged");
+    }
+
+private:
+    std::string_view data;
+    const std::string &file_name;
+    size_t pos = 0;
+}; // class File_reader
+
+
+/* -------------------- save_table -------------------- */
+
+/**
+ * [put_segment: writes <size> bytes at <data> as a segment and records its place in <footer>]
+ */
+static void put_segment(File_writer &out, std::string &footer, const void *data, size_t size)
+{
+    put<uint64_t>(footer, out.position);
+    put<uint64_t>(footer, size);
+    out.write(data, size);
+    out.align();
+}
+
+/**
+ * [put_strings: writes <strings> as a segment of (n + 1) offsets and a segment of their bytes]
+ */
+template <class Strings>
+static void put_strings(File_writer &out, std::string &footer, const Strings &strings)
+{
+    std::string offsets;
+    uint64_t offset = 0;
+    put<uint64_t>(offsets, offset);
+    for (const auto &value : strings) {
+        offset += value.size();
+        put<uint64_t>(offsets, offset);
+    }
+    put_segment(out, footer, offsets.data(), offsets.size());
+
+    put<uint64_t>(footer, out.position);
+    put<uint64_t>(footer, offset);
+    for (const auto &value : strings) {
+        out.write(value.data(), value.size());
+    }
+    out.align();
+}
+
+
+/**
+ * [put_blocks: writes the compressed <values> as a segment of block headers                  ]
+ * [            [u8 kind][u8 bits][u16 0][u32 count][i64 base][i64 step][u64 words] and a segment]
+ * [            of the words of all blocks one after another                                     ]
+ */
+static void put_blocks(File_writer &out, std::string &footer, const Compressed_longs &values)
+{
+    // неполный последний блок в памяти не сжат: в файл он пишется сжатой копией
+    std::deque<Compressed_longs::Block> copies;
+    std::vector<const Compressed_longs::Block *> blocks;
+    for (const auto &block : values.get_blocks()) {
+        blocks.push_back(block.sealed ? &block : &copies.emplace_back(Compressed_longs::sealed(block)));
+    }
+
+    std::string headers;
+    uint64_t words = 0;
+    for (const Compressed_longs::Block *block : blocks) {
+        put<uint8_t>(headers, block->kind);
+        put<uint8_t>(headers, block->bits);
+        put<uint16_t>(headers, 0);
+        put<uint32_t>(headers, block->count);
+        put<int64_t>(headers, block->base);
+        put<int64_t>(headers, block->step);
+        put<uint64_t>(headers, block->words.size());
+        words += block->words.size();
+    }
+    put_segment(out, footer, headers.data(), headers.size());
+
+    put<uint64_t>(footer, out.position);
+    put<uint64_t>(footer, words * sizeof(uint64_t));
+    for (const Compressed_longs::Block *block : blocks) {
+        out.write(block->words.data(), block->words.size() * sizeof(uint64_t));
+    }
+    out.align();
+}
+
+
+void save_table(const Table &table, const std::string &file_name)
+{
+    File_writer out(file_name);
+    out.write(TABLE_MAGIC, sizeof(TABLE_MAGIC));
+
+    // описание собирается по ходу записи сегментов и пишется в конец файла
+    std::string footer;
+    const size_t rows = table.size();
+    put_string(footer, table.table_name);
+    put<uint64_t>(footer, rows);
+    put<uint64_t>(footer, table.deleted_count);
+    put<uint64_t>(footer, table.deleted.size());
+    footer.append(reinterpret_cast<const char *>(table.deleted.data()), table.deleted.size() * sizeof(uint64_t));
+
+    put<uint32_t>(footer, table.ordered_column_names.size());
+    for (const auto &column_name : table.ordered_column_names) {
+        const Table::Column &column = table.table.at(column_name);
+        put_string(footer, column_name);
+        if (column.type == LONG) {
+            put<uint8_t>(footer, ENCODING_BLOCKS);
+            put_blocks(out, footer, column.long_data);
+            put_segment(out, footer, column.zones.data(), column.zones.size() * sizeof(Table::Zone));
+        } else if (column.encoded) {
+            put<uint8_t>(footer, ENCODING_DICTIONARY);
+            put_segment(out, footer, column.codes.data(), rows * sizeof(uint32_t));
+            put_strings(out, footer, column.dictionary);
+        } else {
+            put<uint8_t>(footer, ENCODING_STRINGS);
+            put_strings(out, footer, column.text_data);
+        }
+    }
+
+    put<uint32_t>(footer, table.indexes.size() + table.ordered_indexes.size());
+    for (const auto &index : table.indexes) {
+        put<uint8_t>(footer, INDEX_HASH);
+        put_string(footer, index.first);
+        put_string(footer, index.second.column());
+    }
+    for (const auto &index : table.ordered_indexes) {
+        put<uint8_t>(footer, INDEX_BTREE);
+        put_string(footer, index.first);
+        put_string(footer, index.second.column());
+    }
+
+    uint64_t footer_offset = out.position;
+    out.write(footer.data(), footer.size());
+    out.write(&footer_offset, sizeof(footer_offset));
+    out.write(TABLE_MAGIC, sizeof(TABLE_MAGIC));
+    out.finish();
+}
+
+
+/* -------------------- load_table -------------------- */
+
+// поле, прочитанное из описания
+class Stored_column
+{
+public:
+    std::string name;
+    column_encoding encoding;
+    std::vector<std::string_view> segments; // сегменты поля в отображении
+}; // class Stored_column
+
+/**
+ * [get_segment: reads the place of the next segment from <footer> and returns it from <data>]
+ */
+static std::string_view get_segment(File_reader &footer, std::string_view data, size_t data_end)
+{
+    uint64_t offset = footer.get<uint64_t>(), size = footer.get<uint64_t>();
+    if (offset % 8 != 0 || offset > data_end || size > data_end - offset) {
+        footer.damaged();
+    }
+    return data.substr(offset, size);
+}
+
+/**
+ * [get_strings: checks the segments of offsets and bytes of <count> strings (or of any count if]
+ * [             <count> is -1) and calls <take> for each string                               ]
+ */
+template <class Take>
+static void get_strings(File_reader &footer, std::string_view offsets, std::string_view bytes, size_t count,
+                        Take take)
+{
+    if (offsets.size() % sizeof(uint64_t) != 0 || offsets.empty() ||
+        (count != size_t(-1) && offsets.size() / sizeof(uint64_t) != count + 1)) {
+        footer.damaged();
+    }
+    uint64_t begin, end;
+    memcpy(&begin, offsets.data(), sizeof(begin));
+    for (size_t i = 1; i < offsets.size() / sizeof(uint64_t); ++i) {
+        memcpy(&end, offsets.data() + i * sizeof(uint64_t), sizeof(end));
+        if (end < begin || end > bytes.size()) {
+            footer.damaged();
+        }
+        take(bytes.substr(begin, end - begin));
+        begin = end;
+    }
+}
+
+
+/**
+ * [get_plain_blocks: splits the <rows> uncompressed <values> of an old file into blocks of <target>]
+ */
+static void get_plain_blocks(const std::shared_ptr<const Mapped_file> &file, std::string_view values, size_t rows,
+                             Compressed_longs &target)
+{
+    const uint64_t *words = reinterpret_cast<const uint64_t *>(values.data());
+    for (size_t first = 0; first < rows; first += Compressed_longs::BLOCK_SIZE) {
+        Compressed_longs::Block block;
+        block.count = std::min(Compressed_longs::BLOCK_SIZE, rows - first);
+        block.words = Mapped_vector<uint64_t>(file, words + first, block.count);
+        target.push_block(std::move(block)); // сожмётся при следующей контрольной точке
+    }
+}
+
+/**
+ * [get_blocks: checks the block <headers> and adds the blocks with their words from <values> to <target>]
+ */
+static void get_blocks(const std::string &file_name, const std::shared_ptr<const Mapped_file> &file,
+                       std::string_view headers, std::string_view values, size_t rows, Compressed_longs &target)
+{
+    const uint64_t *words = reinterpret_cast<const uint64_t *>(values.data());
+    const size_t total = values.size() / sizeof(uint64_t);
+    File_reader reader(headers, file_name);
+    size_t offset = 0;
+    for (size_t i = 0; i < headers.size() / BLOCK_HEADER_SIZE; ++i) {
+        Compressed_longs::Block block;
+        block.kind = static_cast<Compressed_longs::encoding>(reader.get<uint8_t>());
+        block.bits = reader.get<uint8_t>();
+        reader.get<uint16_t>();
+        block.count = reader.get<uint32_t>();
+        block.base = reader.get<int64_t>();
+        block.step = reader.get<int64_t>();
+        const uint64_t size = reader.get<uint64_t>();
+        block.sealed = true;
+        if (size > total - offset || (target.size() % Compressed_longs::BLOCK_SIZE != 0)) {
+            reader.damaged(); // все блоки, кроме последнего, полные
+        }
+        block.words = Mapped_vector<uint64_t>(file, words + offset, size);
+        offset += size;
+        if (!block.consistent()) {
+            reader.damaged();
+        }
+        target.push_block(std::move(block));
+    }
+    if (target.size() != rows) {
+        reader.damaged();
+    }
+}
+
+
+void load_table(int key, const std::string &file_name)
+{
+    auto file = std::make_shared<const Mapped_file>(file_name);
+    std::string_view data = file->data();
+    File_reader check(data, file_name);
+
+    // [TABLE_MAGIC] ... [описание][u64 смещение описания][TABLE_MAGIC]
+    const size_t tail = sizeof(uint64_t) + sizeof(TABLE_MAGIC);
+    if (data.size() < sizeof(TABLE_MAGIC) + tail ||
+        memcmp(data.data(), TABLE_MAGIC, sizeof(TABLE_MAGIC)) != 0 ||
+        memcmp(data.data() + data.size() - sizeof(TABLE_MAGIC), TABLE_MAGIC, sizeof(TABLE_MAGIC)) != 0) {
+        check.damaged();
+    }
+    uint64_t footer_offset;
+    memcpy(&footer_offset, data.data() + data.size() - tail, sizeof(footer_offset));
+    if (footer_offset < sizeof(TABLE_MAGIC) || footer_offset > data.size() - tail) {
+        check.damaged();
+    }
+    File_reader footer(data.substr(footer_offset, data.size() - tail - footer_offset), file_name);
+
+    // сначала читаем и проверяем всё описание, и только потом заводим таблицу
+    std::string table_name = footer.get_string();
+    const size_t rows = footer.get<uint64_t>();
+    const size_t deleted_count = footer.get<uint64_t>();
+    std::vector<uint64_t> deleted(footer.get<uint64_t>());
+    std::string_view deleted_bytes = footer.bytes(deleted.size() * sizeof(uint64_t));
+    if (!deleted.empty()) {
+        memcpy(deleted.data(), deleted_bytes.data(), deleted_bytes.size());
+    }
+
+    std::vector<Stored_column> stored(footer.get<uint32_t>());
+    std::vector<std::pair<std::string, std::string>> arguments;
+    for (auto &column : stored) {
+        column.name = footer.get_string();
+        column.encoding = static_cast<column_encoding>(footer.get<uint8_t>());
+        size_t segments = column.encoding == ENCODING_DICTIONARY || column.encoding == ENCODING_BLOCKS ? 3 : 2;
+        if (column.encoding != ENCODING_LONG && column.encoding != ENCODING_DICTIONARY &&
+            column.encoding != ENCODING_STRINGS && column.encoding != ENCODING_BLOCKS) {
+            footer.damaged();
+        }
+        for (size_t i = 0; i < segments; ++i) {
+            column.segments.push_back(get_segment(footer, data, footer_offset));
+        }
+        if ((column.encoding == ENCODING_LONG && (column.segments[0].size() != rows * sizeof(int64_t) ||
+                                                   column.segments[1].size() % sizeof(Table::Zone) != 0)) ||
+            (column.encoding == ENCODING_BLOCKS && (column.segments[0].size() % BLOCK_HEADER_SIZE != 0 ||
+                                                     column.segments[2].size() % sizeof(Table::Zone) != 0)) ||
+            (column.encoding == ENCODING_DICTIONARY && column.segments[0].size() != rows * sizeof(uint32_t))) {
+            footer.damaged();
+        }
+        const bool is_long = column.encoding == ENCODING_LONG || column.encoding == ENCODING_BLOCKS;
+        arguments.emplace_back(column.name, is_long ? "LONG" : "TEXT");
+    }
+    std::vector<std::pair<index_kind, std::pair<std::string, std::string>>> indexes(footer.get<uint32_t>());
+    for (auto &index : indexes) {
+        index.first = static_cast<index_kind>(footer.get<uint8_t>());
+        index.second.first = footer.get_string();
+        index.second.second = footer.get_string();
+    }
+
+    create_table(key, table_name, arguments);
+    Table &table = database.at(key).at(table_name);
+    try {
+        for (const auto &column : stored) {
+            Table::Column &target = table.table.at(column.name);
+            if (column.encoding == ENCODING_LONG || column.encoding == ENCODING_BLOCKS) {
+                // значения не читаются: страницы подгрузятся при первом обращении
+                if (column.encoding == ENCODING_LONG) {
+                    get_plain_blocks(file, column.segments[0], rows, target.long_data);
+                } else {
+                    get_blocks(file_name, file, column.segments[0], column.segments[1], rows, target.long_data);
+                }
+                std::string_view zones = column.segments.back();
+                target.zones.resize(zones.size() / sizeof(Table::Zone));
+                if (!target.zones.empty()) {
+                    memcpy(target.zones.data(), zones.data(), zones.size());
+                }
+            } else if (column.encoding == ENCODING_DICTIONARY) {
+                target.encoded = true;
+                uint32_t code, expected = 0;
+                get_strings(footer, column.segments[1], column.segments[2], size_t(-1), [&](std::string_view value) {
+                    if (!target.encode(value, code) || code != expected++) {
+                        footer.damaged();
+                    }
+                });
+                target.codes = Mapped_vector<uint32_t>(
+                        file, reinterpret_cast<const uint32_t *>(column.segments[0].data()), rows);
+            } else {
+                target.encoded = false;
+                // строки не копируются: они остаются в отображённом файле
+                target.text_data.reserve(rows);
+                get_strings(footer, column.segments[0], column.segments[1], rows, [&](std::string_view value) {
+                    target.text_data.push_back(Short_string(value));
+                });
+                target.text_bytes.adopt(file, column.segments[1].size());
+            }
+        }
+        table.deleted = std::move(deleted);
+        table.deleted_count = deleted_count;
+        for (const auto &index : indexes) {
+            create_index(key, index.second.first, table_name, index.second.second,
+                         index.first == INDEX_BTREE ? "BTREE" : "HASH");
+        }
+    }
+    catch (...) {
+        drop_table(key, table_name); // наполовину прочитанная таблица не остаётся в базе
+        throw;
+    }
+}
+
+
+/* -------------------- open_database / checkpoint_database -------------------- */
+
+/**
+ * [sync_directory: waits until the renames in the <directory> reach the disk]
+ */
+static void sync_directory(const std::string &directory)
+{
+    int fd = open(directory.c_str(), O_RDONLY);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+/**
+ * [table_file: returns the name of the file of the table <table_name> in the <generation>]
+ */
+static std::string table_file(const std::string &table_name, uint64_t generation)
+{
+    return data_directory + "/" + table_name + "." + std::to_string(generation) + TABLE_SUFFIX;
+}
+
+/**
+ * [file_generation: returns the generation of the table file <path> (-1 if it is not a table file)]
+ */
+static uint64_t file_generation(const std::filesystem::path &path)
+{
+    std::string number = path.stem().extension().string(); // <таблица>.<поколение>.tbl
+    if (path.extension() != TABLE_SUFFIX || number.size() < 2 ||
+        number.find_first_not_of("0123456789", 1) != std::string::npos) {
+        return uint64_t(-1);
+    }
+    return std::stoull(number.substr(1));
+}
+
+/**
+ * [remove_stale: removes the table files of all generations except the current one]
+ */
+static void remove_stale()
+{
+    for (const auto &entry : std::filesystem::directory_iterator(data_directory)) {
+        uint64_t generation = file_generation(entry.path());
+        if ((generation != uint64_t(-1) && generation != current_generation) ||
+            entry.path().extension() == ".tmp") {
+            std::filesystem::remove(entry.path()); // остаток прежней или прерванной контрольной точки
+        }
+    }
+}
+
+
+uint64_t open_database(int key, const std::string &directory)
+{
+    data_directory = directory;
+    std::filesystem::create_directories(directory);
+    database[key]; // база клиента существует, даже если таблиц ещё нет
+
+    // CURRENT: "<поколение> <LSN>"; без него контрольных точек ещё не было
+    uint64_t lsn = 0;
+    current_generation = 0;
+    std::ifstream current(directory + "/" + CURRENT_FILE);
+    if (current && !(current >> current_generation >> lsn)) {
+        throw std::runtime_error("file " + directory + "/" + CURRENT_FILE + " is damaged");
+    }
+    remove_stale();
+    for (const auto &entry : std::filesystem::directory_iterator(directory)) {
+        if (file_generation(entry.path()) == current_generation) {
+            load_table(key, entry.path().string());
+        }
+    }
+    return lsn;
+}
+
+
+/**
+ * [write_checkpoint: writes all tables of the client <key> as the <generation> and makes it]
+ * [                  current with the log position <lsn>                                   ]
+ */
+static void write_checkpoint(int key, uint64_t generation, uint64_t lsn)
+{
+    for (const auto &table : database[key]) {
+        save_table(table.second, table_file(table.first, generation));
+    }
+    sync_directory(data_directory);
+
+    // новое поколение становится текущим одним атомарным переименованием
+    const std::string current = data_directory + "/" + CURRENT_FILE;
+    {
+        File_writer out(current + ".tmp");
+        std::string line = std::to_string(generation) + " " + std::to_string(lsn) + "\n";
+        out.write(line.data(), line.size());
+        out.finish();
+    }
+    std::filesystem::rename(current + ".tmp", current);
+    sync_directory(data_directory);
+}
+
+/**
+ * [finish_checkpoint: removes the files the checkpoint <generation> of <lsn> has replaced]
+ * [                   (under <checkpoint_mutex>)                                          ]
+ */
+static void finish_checkpoint(uint64_t generation, uint64_t lsn)
+{
+    current_generation = generation;
+    remove_stale();            // файлы прежнего поколения, в том числе удалённых таблиц
+    wal.remove_segments(lsn);  // всё, что было в этих файлах журнала, теперь есть в файлах таблиц
+}
+
+/**
+ * [private_dirty: returns how many KiB of changed memory the process no longer shares with anyone  ]
+ * [              in its writable mappings; an empty <starts> is filled with the addresses where   ]
+ * [              they begin, otherwise only the mappings beginning at one of <starts> are counted]
+ */
+static uint64_t private_dirty(std::vector<uintptr_t> &starts)
+{
+    // заголовок отображения -- "начало-конец права смещение устройство inode [путь]", за ним строки
+    // вида "Private_Dirty:     1234 kB"; Private_Clean не считаем: это страницы файлов таблиц,
+    // прочитанные с диска, а не копии
+    std::ifstream smaps("/proc/self/smaps");
+    const bool record = starts.empty();
+    bool counted = false; // считаем ли текущее отображение
+    uint64_t total = 0;
+    std::string line;
+    while (std::getline(smaps, line)) {
+        char *end = nullptr;
+        const uintptr_t start = std::strtoull(line.c_str(), &end, 16);
+        if (*end == '-') {
+            if (record) {
+                counted = line.compare(line.find(' ') + 1, 2, "rw") == 0;
+                if (counted) {
+                    starts.push_back(start);
+                }
+            } else {
+                counted = std::binary_search(starts.begin(), starts.end(), start); // адреса идут по порядку
+            }
+        } else if (counted && line.compare(0, 14, "Private_Dirty:") == 0) {
+            total += std::stoull(line.substr(14));
+        }
+    }
+    return total;
+}
+
+/**
+ * [milliseconds: returns the milliseconds passed since <start>]
+ */
+static long long milliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+void checkpoint_database(int key, bool background)
+{
+    std::lock_guard<std::mutex> guard(checkpoint_mutex);
+    if (checkpoint_running) {
+        throw std::runtime_error("the previous background checkpoint is still running");
+    }
+    std::filesystem::create_directories(data_directory);
+    // команда держит блокировку каталога: изменений новее <lsn> нет, и дальше журнал идёт в новый файл
+    const uint64_t lsn = wal.rotate(), generation = current_generation + 1;
+    const auto start = std::chrono::steady_clock::now();
+
+    if (!background) {
+        write_checkpoint(key, generation, lsn);
+        finish_checkpoint(generation, lsn);
+        std::cout << "Checkpoint " << generation << " (LSN " << lsn << ") written in "
+                  << milliseconds(start) << " ms" << std::endl;
+        return;
+    }
+
+    int report[2];
+    if (pipe(report) == -1) {
+        throw std::runtime_error("can't start a background checkpoint");
+    }
+    pid_t child = fork();
+    if (child == -1) {
+        close(report[0]);
+        close(report[1]);
+        throw std::runtime_error("can't start a background checkpoint");
+    }
+    if (child == 0) {
+        // дочерний процесс: из потоков есть только этот, сокеты клиентов ему не нужны
+        dup2(report[1], 3);
+        close_range(4, ~0u, 0);
+        // сразу после fork() изменённая память почти вся общая с сервером; что стало частным
+        // к концу записи -- это страницы, которые сервер за это время изменил (ОС их скопировала),
+        // и немногие, изменённые самим процессом; память, которую процесс выделил себе для записи
+        // (новые отображения и рост кучи за прежние границы), отображениями <mappings> не считается
+        std::vector<uintptr_t> mappings;
+        const uint64_t private_at_fork = private_dirty(mappings);
+        std::string answer(sizeof(uint64_t), '\0'); // [u64 КиБ, скопированные при записи][ошибка]
+        try {
+            write_checkpoint(key, generation, lsn);
+        }
+        catch (std::exception &error) {
+            answer += error.what();
+        }
+        const uint64_t private_at_end = private_dirty(mappings);
+        uint64_t copied = private_at_end > private_at_fork ? private_at_end - private_at_fork : 0;
+        memcpy(answer.data(), &copied, sizeof(copied));
+        ssize_t written = ::write(3, answer.data(), answer.size());
+        _exit(written == ssize_t(answer.size()) && answer.size() == sizeof(copied) ? 0 : 1);
+    }
+
+    close(report[1]);
+    checkpoint_running = true;
+    const long long fork_time = milliseconds(start); // столько сервер стоял: копировались таблицы страниц
+    std::thread([child, answers = report[0], generation, lsn, start, fork_time]() {
+        std::string answer;
+        char buffer[4096];
+        ssize_t bytes;
+        while ((bytes = read(answers, buffer, sizeof(buffer))) > 0 || (bytes == -1 && errno == EINTR)) {
+            answer.append(buffer, std::max<ssize_t>(bytes, 0));
+        }
+        close(answers);
+        int status = 0;
+        waitpid(child, &status, 0);
+
+        std::lock_guard<std::mutex> guard(checkpoint_mutex);
+        checkpoint_running = false;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || answer.size() < sizeof(uint64_t)) {
+            std::cerr << "Checkpoint " << generation << " failed"
+                      << (answer.size() > sizeof(uint64_t) ? ": " + answer.substr(sizeof(uint64_t)) : "")
+                      << std::endl;
+            return;
+        }
+        try {
+            finish_checkpoint(generation, lsn);
+        }
+        catch (std::exception &error) { // поколение уже текущее, остались лишь старые файлы
+            std::cerr << "Checkpoint " << generation << ": " << error.what() << std::endl;
+        }
+        uint64_t copied;
+        memcpy(&copied, answer.data(), sizeof(copied));
+        std::cout << "Checkpoint " << generation << " (LSN " << lsn << ") written in background in "
+                  << milliseconds(start) << " ms (fork " << fork_time << " ms, copy-on-write "
+                  << copied << " KiB)" << std::endl;
+    }).detach();
+}
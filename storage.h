@@ -0,0 +1,67 @@
+#ifndef SQL_INTERPRETER_STORAGE_H
+#define SQL_INTERPRETER_STORAGE_H
+
+#include <cstdint> // uint64_t
+#include <string>  // std::string
+
+#include "table.h" // Table
+
+/* ------------------------------------------------ */
+/* -------------------- STORAGE ------------------- */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] каждая контрольная точка пишет новое поколение файлов и затем атомарно подменяет файл
+ *       <каталог>/CURRENT со строкой "<поколение> <LSN>": после сбоя посреди записи остаётся
+ *       целым прежнее поколение, а журнал повторяется начиная с записи <LSN> + 1
+ */
+
+/**
+ * [NB!] каждая таблица хранится в своём файле <каталог>/<имя таблицы>.<поколение>.tbl, по полям:
+ *       [TABLE_MAGIC][сегменты...][описание][u64 смещение описания][TABLE_MAGIC]
+ *       сегменты выровнены на 8 байт, числа - в порядке байтов машины:
+ *       LONG           -- значения по 8 байт, затем min/max каждого блока;
+ *       TEXT (словарь) -- коды по 4 байта, затем (n + 1) смещений словаря по 8 байт и его строки;
+ *       TEXT (строки)  -- (число строк + 1) смещений по 8 байт, затем сами строки подряд;
+ *       описание: имя таблицы, число строк, битовая карта удалённых строк, имена и типы полей
+ *       в порядке объявления, сегменты каждого поля и определения индексов
+ *       при открытии массивы LONG и коды словаря не читаются, а отображаются из файла
+ */
+
+/**
+ * [save_table: writes the <table> to the file <file_name>]
+ */
+void save_table(const Table &table, const std::string &file_name);
+
+/**
+ * [load_table: adds to the tables of the client <key> the table from the file <file_name>]
+ * [            (throws std::runtime_error if the file is damaged)                         ]
+ */
+void load_table(int key, const std::string &file_name);
+
+/**
+ * [open_database: loads the tables of the last checkpoint in the <directory> for the client <key>]
+ * [               and checkpoints there from now on; returns the LSN of the last log record     ]
+ * [               the checkpoint contains (the directory is created if it does not exist)       ]
+ */
+uint64_t open_database(int key, const std::string &directory);
+
+/**
+ * [NB!] фоновая контрольная точка: сервер делает fork() под блокировкой каталога, и дочерний
+ *       процесс пишет таблицы такими, какими они были в этот момент, пока родитель продолжает
+ *       отвечать клиентам; общие страницы памяти ОС копирует, только когда родитель их меняет;
+ *       длительность точки и объём скопированной памяти сервер выводит, когда она закончится:
+ *       copy-on-write -- на сколько КиБ выросла за время записи изменённая память (Private_Dirty)
+ *       дочернего процесса в отображениях, которые были у него при fork(), то есть сколько памяти
+ *       ОС пришлось скопировать из-за изменений сервера (и немного -- из-за записей самого
+ *       процесса; память, выделенная им заново, сюда не входит)
+ */
+
+/**
+ * [checkpoint_database: writes all tables of the client <key> to the directory of open_database()]
+ * [                     (by default "data") as a new generation and removes the log it replaces; ]
+ * [                     if <background>, the tables are written by a forked process             ]
+ */
+void checkpoint_database(int key, bool background = false);
+
+#endif // SQL_INTERPRETER_STORAGE_H
@@ -1,10 +1,23 @@
-#include <string>    // std::string
-#include <utility>   // std::move(), std::pair, std::make_pair()
+#include <cstdint>   // int64_t, SIZE_MAX
+#include <string>    // std::string, std::to_string()
+#include <utility>   // std::move(), std::pair, std::make_pair(), std::piecewise_construct
+#include <tuple>     // std::forward_as_tuple()
 #include <vector>    // std::vector: push_back()
 #include <map>       // std::map: find(), end(), emplace(), erase(), insert()
-#include <exception> // std::runtime_error(), std::out_of_range
+#include <algorithm> // std::min(), std::max()
+#include <stdexcept> // std::runtime_error(), std::out_of_range, std::length_error
+#include <shared_mutex> // std::shared_mutex, std::shared_lock
+#include <mutex>     // std::unique_lock
+#include <thread>    // std::thread
+#include <string_view> // std::string_view
+#include <charconv>  // std::from_chars()
+#include <system_error> // std::errc
 
 #include "table.h"   // прототипы всех функций, описанных в этом файле
+#include "Where_condition.h" // Where_condition: filter()
+#include "protocol.h" // put_u32(), put_i64(), BINARY_BATCH, MAX_FRAME_SIZE
+#include "csv.h"      // parse_csv()
+#include "mapped.h"   // Mapped_file, Mapped_vector
 
 
 /*----------------------------------------------------------------*/
@@ -14,6 +27,22 @@
  *              {all user tables}   {specific table}
  *----------------------------------------------------------------*/
 
+std::shared_mutex catalog_mutex; // защищает набор таблиц <database> (см. Table_lock)
+
+
+int64_t to_long(std::string_view value)
+{
+    int64_t result = 0;
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (error == std::errc::result_out_of_range) {
+        throw std::runtime_error("the number " + std::string(value) + " does not fit into LONG");
+    }
+    if (error != std::errc() || end != value.data() + value.size()) {
+        throw std::runtime_error("\"" + std::string(value) + "\" is not a LONG value");
+    }
+    return result;
+}
+
 
 /* -------------------- class Column -------------------- */
 
@@ -36,6 +65,185 @@ Table::Column::Column(const std::string &stype)
 }
 
 
+size_t Table::Column::size() const
+{
+    if (type == LONG) {
+        return long_data.size();
+    }
+    return encoded ? codes.size() : text_data.size();
+}
+
+
+void Table::Column::reserve(size_t count)
+{
+    const size_t needed = size() + count;
+    // ёмкость растёт не меньше чем вдвое, иначе частые маленькие пачки копировали бы поле целиком
+    if (type == LONG) {
+        long_data.reserve(needed); // растёт только последний блок
+    } else if (encoded) {
+        if (codes.capacity() < needed)
+            codes.reserve(std::max(needed, 2 * codes.capacity()));
+    } else if (text_data.capacity() < needed) {
+        text_data.reserve(std::max(needed, 2 * text_data.capacity()));
+    }
+}
+
+
+void Table::Column::push_long(int64_t value)
+{
+    long_data.push_back(value);
+    note_value(long_data.size() - 1, value);
+}
+
+
+void Table::Column::push_back(const std::string &value)
+{
+    if (type == LONG) {
+        push_long(to_long(value)); // число разбирается один раз при вставке
+    } else {
+        push_text(value);
+    }
+}
+
+
+std::string Table::Column::to_string(size_t row) const
+{
+    return type == LONG ? std::to_string(long_data[row]) : std::string(text(row));
+}
+
+
+Short_string Table::Column::store_text(std::string_view value)
+{
+    // короткая строка целиком помещается в ячейку, в арену попадают только длинные
+    return Short_string(value.size() <= Short_string::INLINE_SIZE ? value : text_bytes.store(value));
+}
+
+
+void Table::Column::push_text(std::string_view value)
+{
+    if (encoded) {
+        uint32_t code;
+        if (encode(value, code)) {
+            codes.push_back(code);
+            return;
+        }
+        decode(); // значения почти не повторяются - словарь не окупается
+    }
+    text_data.push_back(store_text(value));
+}
+
+
+void Table::Column::set_text(size_t row, std::string_view value)
+{
+    if (encoded) {
+        uint32_t code;
+        if (encode(value, code)) {
+            codes.set(row, code);
+            return;
+        }
+        // <value> не из словаря (иначе код нашёлся бы), поэтому decode() его не испортит
+        decode();
+    }
+    if (!text_data[row].is_inline()) {
+        text_bytes.forget(text_data[row].view());
+    }
+    text_data[row] = store_text(value);
+    if (text_bytes.garbage() >= String_arena::CHUNK_LIMIT && 2 * text_bytes.garbage() > text_bytes.size()) {
+        pack_text(); // больше половины байт арены уже не нужны
+    }
+}
+
+
+bool Table::Column::encode(std::string_view value, uint32_t &code)
+{
+    auto it = dictionary_codes.find(value);
+    if (it != dictionary_codes.end()) {
+        code = it->second;
+        return true;
+    }
+    if (dictionary.size() >= DICTIONARY_LIMIT) {
+        return false;
+    }
+    code = dictionary.size();
+    dictionary.push_back(text_bytes.store(value)); // строки в арене не перемещаются: ключи остаются верными
+    dictionary_codes.emplace(dictionary.back(), code);
+    return true;
+}
+
+
+void Table::Column::decode()
+{
+    text_data.reserve(codes.size());
+    for (uint32_t code : codes) {
+        text_data.push_back(Short_string(dictionary[code])); // байты словаря остаются в арене и делятся строками
+    }
+    codes.release();
+    dictionary_codes.clear();
+    dictionary.clear();
+    encoded = false;
+}
+
+
+void Table::Column::pack_text()
+{
+    String_arena packed;
+    for (Short_string &value : text_data) {
+        if (!value.is_inline()) {
+            value = Short_string(packed.store(value.view()));
+        }
+    }
+    text_bytes = std::move(packed);
+}
+
+
+void Table::Column::set(size_t row, int64_t value)
+{
+    long_data.set(row, value);
+    note_value(row, value);
+}
+
+
+void Table::Column::note_value(size_t row, int64_t value)
+{
+    size_t block = row / BLOCK_SIZE;
+    if (block == zones.size()) { // первая строка нового блока
+        zones.push_back(Zone{value, value});
+    } else {
+        Zone &zone = zones[block];
+        zone.min = std::min(zone.min, value);
+        zone.max = std::max(zone.max, value);
+    }
+}
+
+
+void Table::Column::append(const Column &source, const std::vector<size_t> &rows)
+{
+    if (type == LONG) {
+        long_data.reserve(long_data.size() + rows.size());
+        for (size_t row : rows) {
+            push_long(source.long_data[row]);
+        }
+    } else {
+        for (size_t row : rows) {
+            push_text(source.text(row));
+        }
+    }
+}
+
+
+void Table::Column::clear()
+{
+    long_data.clear();
+    text_data.clear();
+    zones.clear();
+    codes.clear();
+    dictionary_codes.clear();
+    dictionary.clear();
+    text_bytes.clear(); // все строки поля освобождаются разом
+    encoded = true;
+}
+
+
 /* -------------------- class Table -------------------- */
 
 Table::Table() = default;
@@ -54,56 +262,353 @@ Table::Table(const std::string &table_name, std::vector<std::pair<std::string, s
     }
 }
 
+size_t Table::size() const
+{
+    return table.empty() ? 0 : table.begin()->second.size();
+}
+
 void Table::clear()
 {
     this->table.clear();
     this->ordered_column_names.clear();
     this->table_name.clear();
+    this->deleted.clear();
+    this->deleted_count = 0;
+    // индексы ссылаются на номера строк и поля очищенной таблицы
+    this->indexes.clear();
+    this->ordered_indexes.clear();
+}
+
+void Table::mark_deleted(size_t row)
+{
+    if (row / 64 >= deleted.size()) {
+        deleted.resize(row / 64 + 1, 0);
+    }
+    uint64_t bit = uint64_t(1) << (row % 64);
+    if (!(deleted[row / 64] & bit)) {
+        deleted[row / 64] |= bit;
+        ++deleted_count;
+    }
+}
+
+void Table::compact()
+{
+    std::vector<size_t> live_rows; // номера неудалённых строк
+    size_t rows = size();
+    live_rows.reserve(rows - deleted_count);
+    for (size_t row = 0; row < rows; ++row) {
+        if (!is_deleted(row))
+            live_rows.push_back(row);
+    }
+    for (auto &column : table) {
+        Column compacted(column.second.type);
+        compacted.encoded = column.second.encoded; // не кодируем заново поле, уже отказавшееся от словаря
+        compacted.append(column.second, live_rows);
+        column.second = std::move(compacted);
+    }
+    deleted.clear();
+    deleted_count = 0;
+    rebuild_indexes(); // номера строк изменились
+}
+
+void Table::index_row(size_t row)
+{
+    for (auto &index : indexes) {
+        const Column &column = table.at(index.second.column());
+        if (column.type == LONG) {
+            index.second.insert(column.long_data[row], row);
+        } else {
+            index.second.insert(column.text(row), row);
+        }
+    }
+    for (auto &index : ordered_indexes) {
+        index.second.insert(table.at(index.second.column()).long_data[row], row);
+    }
+}
+
+void Table::unindex_rows(const std::vector<size_t> &rows)
+{
+    for (auto &index : indexes) {
+        const Column &column = table.at(index.second.column());
+        if (column.type == LONG) {
+            std::vector<std::pair<int64_t, size_t>> entries;
+            entries.reserve(rows.size());
+            for (size_t row : rows) {
+                entries.emplace_back(column.long_data[row], row);
+            }
+            index.second.erase(entries);
+        } else {
+            std::vector<std::pair<std::string_view, size_t>> entries;
+            entries.reserve(rows.size());
+            for (size_t row : rows) {
+                entries.emplace_back(column.text(row), row);
+            }
+            index.second.erase(entries);
+        }
+    }
+    for (auto &index : ordered_indexes) {
+        const Column &column = table.at(index.second.column());
+        for (size_t row : rows) {
+            index.second.erase(column.long_data[row], row);
+        }
+    }
+}
+
+void Table::rebuild_indexes()
+{
+    for (auto &index : indexes) {
+        index.second.clear();
+        const Column &column = table.at(index.second.column());
+        for (size_t row = 0; row < size(); ++row) {
+            if (is_deleted(row)) {
+                continue;
+            }
+            if (column.type == LONG) {
+                index.second.insert(column.long_data[row], row);
+            } else {
+                index.second.insert(column.text(row), row);
+            }
+        }
+    }
+    for (auto &index : ordered_indexes) {
+        // дерево строится снизу вверх по отсортированным записям
+        const Column &column = table.at(index.second.column());
+        std::vector<std::pair<int64_t, size_t>> entries;
+        entries.reserve(size() - deleted_count);
+        for (size_t row = 0; row < size(); ++row) {
+            if (!is_deleted(row))
+                entries.emplace_back(column.long_data[row], row);
+        }
+        index.second.build(entries);
+    }
+}
+
+const Hash_index *Table::hash_index(const std::string &column_name) const
+{
+    for (const auto &index : indexes) {
+        if (index.second.column() == column_name)
+            return &index.second;
+    }
+    return nullptr;
+}
+
+const std::vector<Table::Zone> *Table::zones(const std::string &column_name) const
+{
+    const Column &column = table.at(column_name);
+    return column.type == LONG ? &column.zones : nullptr;
+}
+
+const Btree_index *Table::ordered_index(const std::string &column_name) const
+{
+    for (const auto &index : ordered_indexes) {
+        if (index.second.column() == column_name)
+            return &index.second;
+    }
+    return nullptr;
 }
 
 void
 select_from_table(int key, const std::string &table_name,
                   std::vector<std::string> &field_names,
                   Where_condition &where,
-                  Table &selected_table)
+                  Table_view &selected_table)
 {
-    auto table = database.at(key).at(table_name).table;
-    std::vector<std::pair<std::string, std::string>> columns;
+    const Table &table = database.at(key).at(table_name); // читаем таблицу по ссылке, без копирования
     selected_table.clear();
-    selected_table.table_name = table_name;
-    for (auto &col_name : field_names) {
-        Table::Column new_col = Table::Column(table[col_name]);
-        std::vector<std::string> new_values;
-        for (const std::string &item: new_col.data) {
-            if (where.condition(item))
-                new_values.push_back(item);
-        }
-        new_col.data = new_values;
-        selected_table.table.emplace(col_name, new_col);
+    selected_table.table = &table;
+
+    if (field_names.size() == 1 && field_names[0] == "*") {
+        selected_table.column_names = table.ordered_column_names;
+    } else {
+        selected_table.column_names = field_names;
+    }
+    for (auto &col_name : selected_table.column_names) {
+        selected_table.columns.push_back(&table.table.at(col_name));
     }
+
+    // один проход фильтра: номера строк, удовлетворяющих where-условию
+    where.filter(table, selected_table.rows);
 }
 
 
 void insert_into_table(int key, const std::string &table_name, std::vector<std::string> &new_record)
 {
     Table &user_table = database.at(key).at(table_name); // получаем доступ к таблице <table_name> клиента <key>
-    int i = 0;
-    for (auto &col_name : user_table.ordered_column_names) {
-        user_table.table[col_name].data.push_back(
-                new_record[i++]); // добавляем новую запись из <new_record> в поля таблицы <table_name>
+    const size_t width = user_table.ordered_column_names.size();
+    if (width == 0 || new_record.size() % width != 0) {
+        throw std::runtime_error("mismatch of the number of parameters");
+    }
+    const size_t first = user_table.size(), count = new_record.size() / width;
+
+    // числа разбираются до первой записи в таблицу: неверное значение не оставит вставленной часть строк
+    std::vector<Table::Column *> columns(width);
+    std::vector<int64_t> numbers(new_record.size());
+    for (size_t col = 0; col < width; ++col) {
+        columns[col] = &user_table.table[user_table.ordered_column_names[col]];
+        if (columns[col]->type == LONG) {
+            for (size_t i = col; i < new_record.size(); i += width) {
+                numbers[i] = to_long(new_record[i]);
+            }
+        }
+    }
+
+    // записи добавляются по полям: каждое поле растёт один раз на всю пачку
+    for (size_t col = 0; col < width; ++col) {
+        Table::Column &column = *columns[col];
+        column.reserve(count);
+        for (size_t i = col; i < new_record.size(); i += width) {
+            if (column.type == LONG) {
+                column.push_long(numbers[i]);
+            } else {
+                column.push_text(new_record[i]);
+            }
+        }
+    }
+    for (size_t row = first; row < first + count; ++row) {
+        user_table.index_row(row);
     }
 }
 
 
-void update_table(int key, const std::string &table_name, std::string &column_name, const std::string &new_value,
+void copy_into_table(int key, const std::string &table_name, std::string_view csv)
+{
+    Table &user_table = database.at(key).at(table_name); // получаем доступ к таблице <table_name> клиента <key>
+    std::vector<object_type> types;
+    for (const auto &col_name : user_table.ordered_column_names) {
+        types.push_back(user_table.table.at(col_name).type);
+    }
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // текст разбирается целиком до первой записи в таблицу: при ошибке таблица не меняется
+    std::vector<Csv_chunk> chunks = parse_csv(csv, types, threads);
+    size_t count = 0;
+    for (const auto &chunk : chunks) {
+        count += chunk.rows;
+    }
+    const size_t first = user_table.size();
+
+    // поля независимы: поток <worker> дописывает поля worker, worker + threads, ...
+    // (потоков не больше, чем ядер, сколько бы полей ни было в таблице)
+    threads = std::min(threads, types.size());
+    auto append = [&](size_t worker) {
+        for (size_t col = worker; col < types.size(); col += threads) {
+            Table::Column &column = user_table.table.at(user_table.ordered_column_names[col]);
+            column.reserve(count);
+            for (const auto &chunk : chunks) {
+                if (column.type == LONG) {
+                    for (int64_t value : chunk.columns[col].longs) {
+                        column.push_long(value);
+                    }
+                } else {
+                    for (std::string_view value : chunk.columns[col].texts) {
+                        column.push_text(value);
+                    }
+                }
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t worker = 1; worker < threads; ++worker) {
+        workers.emplace_back(append, worker);
+    }
+    if (threads != 0) {
+        append(0);
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    for (size_t row = first; row < first + count; ++row) {
+        user_table.index_row(row);
+    }
+}
+
+
+void update_table(int key, const std::string &table_name, std::string &column_name, Expression &new_value,
                   Where_condition &where)
 {
     Table &user_table = database.at(key).at(table_name); // получаем доступ к таблице <table_name> клиента <key>
-    Table::Column column = user_table.table[column_name];
-    for (int i = 0; i < column.data.size(); ++i) {
-        std::string changed_field = column.data[i];
-        if (where.condition(changed_field))
-            column.data[i] = new_value;   // вносим изменения в указанные поля таблицы
+    Table::Column &column = user_table.table.at(column_name); // изменяем само поле, а не его копию
+
+    std::vector<size_t> rows; // номера изменяемых строк вычисляются один раз
+    where.filter(user_table, rows);
+    new_value.bind(user_table);
+
+    // индексы по изменяемому полю
+    std::vector<Hash_index *> indexes;
+    for (auto &index : user_table.indexes) {
+        if (index.second.column() == column_name)
+            indexes.push_back(&index.second);
+    }
+    std::vector<Btree_index *> ordered_indexes;
+    for (auto &index : user_table.ordered_indexes) {
+        if (index.second.column() == column_name)
+            ordered_indexes.push_back(&index.second);
+    }
+
+    // сначала вычисляются все новые значения: ошибка в любой пачке (деление на ноль, переполнение)
+    // не должна оставить таблицу изменённой наполовину
+    std::vector<int64_t> long_values;
+    std::vector<std::string_view> text_values;
+    String_arena new_bytes; // копии новых строк: результат пачки переписывается следующей
+    if (column.type == LONG) {
+        long_values.reserve(rows.size());
+    } else {
+        text_values.reserve(rows.size());
+    }
+    for (size_t begin = 0; begin < rows.size(); begin += Expression::BATCH_SIZE) {
+        const size_t count = std::min(Expression::BATCH_SIZE, rows.size() - begin);
+        new_value.evaluate(rows.data() + begin, count);
+        for (size_t i = 0; i < count; ++i) {
+            if (column.type == LONG) {
+                long_values.push_back(new_value.long_result(i));
+            } else {
+                text_values.push_back(new_bytes.store(new_value.text_result(i).view()));
+            }
+        }
+    }
+
+    // затем значения записываются на место; старые значения удаляются из хеш-индексов одной пачкой
+    for (Hash_index *index : indexes) {
+        if (column.type == LONG) {
+            std::vector<std::pair<int64_t, size_t>> entries;
+            entries.reserve(rows.size());
+            for (size_t row : rows) {
+                entries.emplace_back(column.long_data[row], row);
+            }
+            index->erase(entries);
+        } else {
+            std::vector<std::pair<std::string_view, size_t>> entries;
+            entries.reserve(rows.size());
+            for (size_t row : rows) {
+                entries.emplace_back(column.text(row), row);
+            }
+            index->erase(entries);
+        }
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (column.type == LONG) {
+                index->insert(long_values[i], rows[i]);
+            } else {
+                index->insert(text_values[i], rows[i]);
+            }
+        }
+    }
+    for (Btree_index *index : ordered_indexes) {
+        for (size_t i = 0; i < rows.size(); ++i) {
+            index->erase(column.long_data[rows[i]], rows[i]);
+            index->insert(long_values[i], rows[i]);
+        }
+    }
+    if (column.type == LONG) {
+        for (size_t i = 0; i < rows.size(); ++i) {
+            column.set(rows[i], long_values[i]);
+        }
+    } else {
+        for (size_t i = 0; i < rows.size(); ++i) {
+            column.set_text(rows[i], text_values[i]);
+        }
+    }
+    if (column.type == LONG) {
+        column.long_data.compress(); // изменённые блоки хранились распакованными
     }
 }
 
@@ -111,9 +616,17 @@ void update_table(int key, const std::string &table_name, std::string &column_na
 void delete_table(int key, const std::string &table_name, Where_condition &where)
 {
     Table &user_table = database.at(key).at(table_name); // получаем доступ к таблице <table_name> клиента <key>
-    //todo
-    for (auto &column:user_table.table) {
-        column.second.data.clear();
+
+    std::vector<size_t> rows;
+    where.filter(user_table, rows);
+    user_table.unindex_rows(rows);
+    for (size_t row : rows) {
+        user_table.mark_deleted(row); // строки только помечаются, поля не переписываются
+    }
+
+    // вычищаем удалённые строки, когда их накопилось достаточно много
+    if (user_table.deleted_count * Table::COMPACTION_RATIO >= user_table.size()) {
+        user_table.compact();
     }
 }
 
@@ -127,8 +640,9 @@ void create_table(int key, const std::string &table_name,
         user_database.end()) { // таблица с именем <table_name> уже существует в базе данных клиента
         throw std::runtime_error("table with name \'" + table_name + "\' already exist");
     }
-    // создаём таблицу с именем <table_name> и инициализируем поля таблицы в классе Table
-    user_database.insert(std::make_pair(table_name, Table(table_name, columns)));
+    // создаём таблицу с именем <table_name> прямо в базе: таблица с блокировкой не перемещается
+    user_database.emplace(std::piecewise_construct, std::forward_as_tuple(table_name),
+                          std::forward_as_tuple(table_name, columns));
 }
 
 void drop_table(int key, const std::string &table_name)
@@ -137,6 +651,26 @@ void drop_table(int key, const std::string &table_name)
 }
 
 
+void create_index(int key, const std::string &index_name, const std::string &table_name,
+                  const std::string &column_name, const std::string &index_type)
+{
+    if (index_exist(key, index_name)) {
+        throw std::runtime_error("index with name \'" + index_name + "\' already exist");
+    }
+    Table &user_table = database.at(key).at(table_name); // получаем доступ к таблице <table_name> клиента <key>
+    const Table::Column &column = user_table.table.at(column_name); // поле должно существовать
+    if (index_type == "BTREE") {
+        if (column.type != LONG) {
+            throw std::runtime_error("BTREE index can only be created on a LONG field");
+        }
+        user_table.ordered_indexes.emplace(index_name, Btree_index(column_name));
+    } else {
+        user_table.indexes.emplace(index_name, Hash_index(column_name));
+    }
+    user_table.rebuild_indexes();                        // заполняем индекс уже имеющимися строками
+}
+
+
 object_type get_object_type(int key, const std::string &table_name, const std::string &object_name)
 {
     try {
@@ -180,29 +714,46 @@ bool object_exist(int key, const std::string &table_name, const std::string &obj
 }
 
 
+bool index_exist(int key, const std::string &index_name)
+{
+    auto user_it = database.find(key); // возвращает pair<key, map<...>>
+    if (user_it == database.end()) {   // клиента с <key> нет в базе данных
+        return false;
+    }
+    for (const auto &user_table : (*user_it).second) {
+        if (user_table.second.indexes.find(index_name) != user_table.second.indexes.end() ||
+            user_table.second.ordered_indexes.find(index_name) != user_table.second.ordered_indexes.end()) {
+            return true;               // имя индекса уникально среди всех таблиц клиента
+        }
+    }
+
+    return false;
+}
+
+
 void check_param(int key, const std::string &table_name, std::vector<std::string> &actual_param)
 {
     if (!table_exist(key, table_name)) {
         throw std::runtime_error("table with the given name does not exist");
     }
 
-    auto column_names = database.at(key).at(table_name).ordered_column_names;
+    Table &user_table = database.at(key).at(table_name);
+    const auto &column_names = user_table.ordered_column_names;
 
-    if (actual_param.size() != column_names.size()) {
+    // типы полей выясняются один раз на всю пачку записей
+    std::vector<object_type> types;
+    for (const auto &column_name : column_names) {
+        types.push_back(user_table.table.at(column_name).type);
+    }
+    if (actual_param.empty() || types.empty() || actual_param.size() % types.size() != 0) {
         throw std::runtime_error("mismatch of the number of parameters");
     }
-    int param_size = column_names.size() - 1;
-    for (int i = 0; i < column_names.size(); ++i) {
-        if ((database.at(key).at(table_name).table[column_names[param_size - i]].type == TEXT && actual_param[i] == "LONG") ||
-            (database.at(key).at(table_name).table[column_names[param_size - i]].type == LONG && actual_param[i] == "TEXT")) {
-            if (database.at(key).at(table_name).table[column_names[i]].type == TEXT) {
-                throw std::runtime_error("type mismatch, TEXT type field expected");
-            } else if (database.at(key).at(table_name).table[column_names[param_size - i]].type == LONG) {
-                throw std::runtime_error("type mismatch, LONG type field expected");
-            } else {
-                throw std::runtime_error("type mismatch");
-            }
-
+    for (size_t i = 0; i < actual_param.size(); ++i) {
+        object_type type = types[i % types.size()];
+        if (type == TEXT && actual_param[i] == "LONG") {
+            throw std::runtime_error("type mismatch, TEXT type field expected");
+        } else if (type == LONG && actual_param[i] == "TEXT") {
+            throw std::runtime_error("type mismatch, LONG type field expected");
         }
     }
 }
@@ -210,13 +761,198 @@ void check_param(int key, const std::string &table_name, std::vector<std::string
 std::string Table::to_string()
 {
     std::string str = "\nSELECTED FROM: " + table_name + "\n";
-    for (auto &col: table) {
-        str += "--- COLUMN NAME: " + col.first + "\n";
-        int i = 0;
-        for (auto &item: col.second.data) {
-            str += std::to_string(i++) + ": " + item + "\n";
+    for (auto &col_name: ordered_column_names) {
+        const Column &column = table.at(col_name);
+        str += "--- COLUMN NAME: " + col_name + "\n";
+        for (size_t i = 0; i < column.size(); ++i) {
+            str += std::to_string(i) + ": " + column.to_string(i) + "\n";
         }
         str += "\n";
     }
     return std::string(str);
 }
+
+
+/* -------------------- class Table_lock -------------------- */
+
+void Table_lock::lock(int key, const std::string &table_name, lock_mode mode)
+{
+    unlock();
+    if (mode == CATALOG) {
+        catalog_write = std::unique_lock<std::shared_mutex>(catalog_mutex);
+        return;
+    }
+
+    catalog_read = std::shared_lock<std::shared_mutex>(catalog_mutex);
+    auto user_it = database.find(key);
+    if (user_it == database.end()) {
+        return;
+    }
+    auto table_it = user_it->second.find(table_name);
+    if (table_it == user_it->second.end()) {
+        return;
+    }
+    if (mode == READ) {
+        table_read = std::shared_lock<std::shared_mutex>(table_it->second.mutex);
+    } else {
+        table_write = std::unique_lock<std::shared_mutex>(table_it->second.mutex);
+    }
+}
+
+
+void Table_lock::unlock()
+{
+    // снимаем в порядке, обратном захвату
+    if (table_write.owns_lock()) table_write.unlock();
+    if (table_read.owns_lock()) table_read.unlock();
+    if (catalog_write.owns_lock()) catalog_write.unlock();
+    if (catalog_read.owns_lock()) catalog_read.unlock();
+}
+
+
+/* -------------------- class Table_view -------------------- */
+
+Table_view::Table_view() = default;
+
+
+size_t Table_view::size() const
+{
+    return rows.size();
+}
+
+
+void Table_view::header(std::string &out) const
+{
+    if (table == nullptr) {
+        return;
+    }
+    out += "\nSELECTED FROM: " + table->table_name + "\n--- COLUMNS: ";
+    for (size_t col = 0; col < column_names.size(); ++col) {
+        out += (col == 0? "": " | ") + column_names[col];
+    }
+    out += "\n";
+}
+void Table_view::write_row(std::string &out, size_t i) const
+{
+    out += std::to_string(i) + ": ";
+    for (size_t col = 0; col < columns.size(); ++col) {
+        if (col != 0) {
+            out += " | ";
+        }
+        out += columns[col]->to_string(rows[i]);
+    }
+    out += "\n";
+}
+size_t Table_view::write_rows(std::string &out, size_t first, size_t limit) const
+{
+    size_t i = first;
+    // строки выводятся целиком, поэтому <out> может немного перерасти <limit>, но не размер кадра
+    for (; i < rows.size() && out.size() < limit; ++i) {
+        const size_t size = out.size();
+        write_row(out, i);
+        if (out.size() > MAX_FRAME_SIZE) {
+            out.resize(size);
+            if (out.empty()) {
+                throw std::length_error("record " + std::to_string(i) + " is longer than a frame");
+            }
+            break; // строка уйдёт следующим кадром
+        }
+    }
+    return i;
+}
+void Table_view::schema(std::string &out) const
+{
+    if (table == nullptr) {
+        return;
+    }
+    put_u32(out, table->table_name.size());
+    out += table->table_name;
+    put_u32(out, columns.size());
+    for (size_t col = 0; col < columns.size(); ++col) {
+        out += static_cast<char>(columns[col]->type == LONG? BINARY_LONG: BINARY_TEXT);
+        put_u32(out, column_names[col].size());
+        out += column_names[col];
+    }
+}
+size_t Table_view::write_batches(std::string &out, size_t first, size_t limit) const
+{
+    size_t fixed = 0, texts = 0; // байты строки в пачке без самих строк TEXT; число полей TEXT
+    for (const Table::Column *column : columns) {
+        if (column->type == LONG) {
+            fixed += 8;
+        } else {
+            fixed += 4;
+            ++texts;
+        }
+    }
+    size_t i = first;
+    while (i < rows.size() && out.size() < limit) {
+        // пачка заканчивается на BINARY_BATCH строках или там, где кадр достиг бы MAX_FRAME_SIZE
+        // (тогда и смещения u32 внутри пачки не переполняются)
+        const size_t overhead = out.size() + 4 + 4 * texts; // число строк и последнее смещение полей
+        size_t budget = MAX_FRAME_SIZE > overhead ? MAX_FRAME_SIZE - overhead : 0;
+        size_t batch = 0;
+        for (const size_t end = std::min(BINARY_BATCH, rows.size() - i); batch < end; ++batch) {
+            size_t size = fixed;
+            if (texts != 0) {
+                for (const Table::Column *column : columns) {
+                    if (column->type == TEXT) {
+                        size += column->text(rows[i + batch]).size();
+                    }
+                }
+            }
+            if (size > budget) {
+                break;
+            }
+            budget -= size;
+        }
+        if (batch == 0) {
+            if (out.empty()) {
+                throw std::length_error("record " + std::to_string(i) + " is longer than a frame");
+            }
+            break; // строка уйдёт следующим кадром
+        }
+        put_u32(out, batch);
+        for (const Table::Column *column : columns) {
+            if (column->type == LONG) {
+                int64_t values[BINARY_BATCH];
+                column->long_data.gather(rows.data() + i, batch, values);
+                for (size_t j = 0; j < batch; ++j) {
+                    put_i64(out, values[j]);
+                }
+                continue;
+            }
+            // смещения строк известны заранее: массив заполняется на месте, строки дописываются следом
+            size_t offsets = out.size();
+            out.resize(offsets + 4 * (batch + 1));
+            size_t data = out.size();
+            for (size_t j = i; j <= i + batch; ++j) {
+                uint32_t offset = out.size() - data;
+                for (int byte = 0; byte < 4; ++byte) {
+                    out[offsets + 4 * (j - i) + byte] = static_cast<char>(offset >> (8 * byte));
+                }
+                if (j < i + batch) {
+                    out += column->text(rows[j]);
+                }
+            }
+        }
+        i += batch;
+    }
+    return i;
+}
+std::string Table_view::to_string() const
+{
+    std::string str;
+    header(str);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        write_row(str, i); // текст результата целиком - не кадр, его размер не ограничен
+    }
+    return str;
+}
+void Table_view::clear()
+{
+    table = nullptr;
+    column_names.clear();
+    columns.clear();
+    rows.clear(); // память вектора выборки переиспользуется следующим запросом
+}
@@ -1,11 +1,25 @@
 #ifndef SQL_INTERPRETER_TABLE_H
 #define SQL_INTERPRETER_TABLE_H
 
+#include <cstdint>  // int64_t
+#include <cstddef>  // size_t
 #include <string>   // std::string
+#include <string_view> // std::string_view
 #include <utility>  // std::pair
 #include <vector>   // std::vector
 #include <map>      // std::map
-#include "Where_condition.h"
+#include <unordered_map> // std::unordered_map
+#include <shared_mutex> // std::shared_mutex, std::shared_lock
+#include <mutex>    // std::unique_lock
+#include "index.h"  // Hash_index, Btree_index
+#include "mapped.h" // Mapped_vector
+#include "compression.h" // Compressed_longs
+#include "arena.h"  // String_arena
+#include "short_string.h" // Short_string
+
+class Where_condition;
+class Expression;
+class Table_view;
 
 /* ------------------------------------------------ */
 /* -------------------- TABLE --------------------- */
@@ -18,14 +32,40 @@ enum object_type
     LONG
 };
 
+/**
+ * [to_long: converts the decimal <value> to LONG (throws std::runtime_error if it is not a number]
+ * [         or does not fit into 64 bits)                                                        ]
+ */
+int64_t to_long(std::string_view value);
+
 class Table
 {
+public:
+    static const size_t BLOCK_SIZE = Compressed_longs::BLOCK_SIZE; // число строк в блоке поля
+
+    class Zone
+    {
+    public:
+        int64_t min; // наименьшее значение в блоке
+        int64_t max; // наибольшее значение в блоке
+    }; // class Zone
+
 private:
     class Column
     {
     public:
-        object_type type;              // тип поля
-        std::vector<std::string> data; // содержимое поля
+        object_type type;                   // тип поля
+        Compressed_longs long_data;         // содержимое поля типа LONG (сжатое по блокам)
+        std::vector<Short_string> text_data; // содержимое поля типа TEXT (байты длинных строк в text_bytes)
+        std::vector<Zone> zones;            // min/max каждого блока из BLOCK_SIZE строк (для LONG)
+
+        bool encoded = true;                // поле TEXT хранится кодами словаря
+        Mapped_vector<uint32_t> codes;      // коды значений поля TEXT (если encoded)
+        std::vector<std::string_view> dictionary; // различные значения поля TEXT, код - позиция в словаре
+        std::unordered_map<std::string_view, uint32_t> dictionary_codes; // значение -> код
+        String_arena text_bytes;            // байты строк text_data и dictionary
+
+        static const size_t DICTIONARY_LIMIT = 65536; // больше различных значений - храним строки
 
         /**
          * [constructor: default]
@@ -41,12 +81,126 @@ private:
          * [constructor: initialize field type]
          */
         Column(const std::string &stype);
+
+        /**
+         * [size: returns the number of records in the column]
+         */
+        size_t size() const;
+
+        /**
+         * [reserve: makes room for <count> more records]
+         */
+        void reserve(size_t count);
+
+        /**
+         * [push_back: converts <value> to the column type and appends it to the column]
+         */
+        void push_back(const std::string &value);
+
+        /**
+         * [to_string: returns the record <row> in text form]
+         */
+        std::string to_string(size_t row) const;
+
+        /**
+         * [text: returns the record <row> of a TEXT column]
+         */
+        std::string_view text(size_t row) const
+        {
+            return encoded ? dictionary[codes[row]] : text_data[row].view();
+        }
+
+        /**
+         * [push_long: appends <value> to a LONG column]
+         */
+        void push_long(int64_t value);
+
+        /**
+         * [store_text: returns the cell of <value>, copying a long <value> into the arena]
+         */
+        Short_string store_text(std::string_view value);
+
+        /**
+         * [push_text/set_text: append <value> to / write <value> into the record <row> of a TEXT column]
+         */
+        void push_text(std::string_view value);
+        void set_text(size_t row, std::string_view value);
+
+        /**
+         * [encode: finds or adds the code of <value>; returns false if the dictionary is full]
+         */
+        bool encode(std::string_view value, uint32_t &code);
+
+        /**
+         * [decode: converts the column from dictionary codes to plain strings]
+         */
+        void decode();
+
+        /**
+         * [pack_text: copies the strings still in use into a new arena (too much garbage in the old one)]
+         */
+        void pack_text();
+
+        /**
+         * [set: writes <value> into the record <row> of a LONG column]
+         */
+        void set(size_t row, int64_t value);
+
+        /**
+         * [note_value: takes the <value> of the record <row> into account in the min/max of its block]
+         */
+        void note_value(size_t row, int64_t value);
+
+        /**
+         * [append: appends the records <rows> of the column <source> of the same type]
+         */
+        void append(const Column &source, const std::vector<size_t> &rows);
+
+        /**
+         * [clear: removes all records from the column]
+         */
+        void clear();
     }; // class Column
 
     std::string table_name;              // имя таблицы
     std::map<std::string, Column> table; // таблица <имя поля, содержимое>
     std::vector<std::string> ordered_column_names; // здесь хранятся имена полей по порядку
 
+    std::vector<uint64_t> deleted; // битовая карта удалённых строк (по биту на строку)
+    size_t deleted_count = 0;      // число удалённых, но ещё не вычищенных строк
+
+    static const size_t COMPACTION_RATIO = 4; // уплотняем, когда удалено >= 1/4 строк
+
+    std::map<std::string, Hash_index> indexes;          // хеш-индексы таблицы <имя индекса, индекс>
+    std::map<std::string, Btree_index> ordered_indexes; // упорядоченные индексы <имя индекса, индекс>
+
+    mutable std::shared_mutex mutex; // SELECT читают таблицу совместно, изменения - монопольно
+
+    /**
+     * [mark_deleted: marks the record <row> as deleted]
+     */
+    void mark_deleted(size_t row);
+
+    /**
+     * [compact: removes deleted records from the columns and clears the deletion bitmap]
+     */
+    void compact();
+
+    /**
+     * [index_row: adds the record <row> to all indexes of the table]
+     */
+    void index_row(size_t row);
+
+    /**
+     * [unindex_rows: removes the records <rows> from all indexes of the table]
+     */
+    void unindex_rows(const std::vector<size_t> &rows);
+
+    /**
+     * [rebuild_indexes: fills all indexes of the table anew]
+     */
+    void rebuild_indexes();
+
 public:
     /**
      * [constructor: default]
@@ -59,6 +213,43 @@ public:
      */
     Table(const std::string &table_name, std::vector<std::pair<std::string, std::string>> &columns);
 
+    /**
+     * [size: returns the number of records in the table, including deleted ones]
+     */
+    size_t size() const;
+
+    /**
+     * [has_deleted: returns true if the table contains deleted records]
+     */
+    bool has_deleted() const
+    {
+        return deleted_count != 0;
+    }
+
+    /**
+     * [is_deleted: returns true if the record <row> is deleted]
+     */
+    bool is_deleted(size_t row) const
+    {
+        return row / 64 < deleted.size() && (deleted[row / 64] >> (row % 64) & 1);
+    }
+
+    /**
+     * [hash_index: returns the hash index on the field <column_name>; nullptr if there is none]
+     */
+    const Hash_index *hash_index(const std::string &column_name) const;
+
+    /**
+     * [zones: returns the min/max of the blocks of the LONG field <column_name>; nullptr for TEXT]
+     * [       (after UPDATE and DELETE the range of a block may be wider than the actual one)   ]
+     */
+    const std::vector<Zone> *zones(const std::string &column_name) const;
+
+    /**
+     * [ordered_index: returns the B+-tree index on the field <column_name>; nullptr if there is none]
+     */
+    const Btree_index *ordered_index(const std::string &column_name) const;
+
     /**
      * [to_string: represent table as string]
      */
@@ -74,6 +265,11 @@ public:
      *              но не дублировать код функций для каждого объекта
      */
 
+    friend class Expression; // вычисление выражений по полям таблицы
+    friend class Table_view; // чтение выбранных полей без копирования
+    friend class Where_condition; // LIKE и IN по словарю поля
+    friend class Table_lock;      // блокировка таблицы на время команды
+
 
     /*-----------------------------------*/
     /* functions for working with tables */
@@ -91,13 +287,22 @@ public:
     friend void
     select_from_table(int key, const std::string &table_name, std::vector<std::string> &field_names,
                       Where_condition &where,
-                      Table &selected_table);
+                      Table_view &selected_table);
 
     friend void
     insert_into_table(int key, const std::string &table_name, std::vector<std::string> &new_record);
 
     friend void
-    update_table(int key, const std::string &table_name, std::string &column_name, const std::string &new_value,
+    copy_into_table(int key, const std::string &table_name, std::string_view csv);
+
+    friend void
+    save_table(const Table &table, const std::string &file_name);
+
+    friend void
+    load_table(int key, const std::string &file_name);
+
+    friend void
+    update_table(int key, const std::string &table_name, std::string &column_name, Expression &new_value,
                  Where_condition &where);
 
     friend void
@@ -109,6 +314,10 @@ public:
     friend void
     drop_table(int key, const std::string &table_name);
 
+    friend void
+    create_index(int key, const std::string &index_name, const std::string &table_name,
+                 const std::string &column_name, const std::string &index_type);
+
 
     /*---------------------------------*/
     /* functions for semantic analysis */
@@ -127,34 +336,162 @@ public:
     friend bool
     object_exist(int key, const std::string &table_name, const std::string &object_name);
 
+    friend bool
+    index_exist(int key, const std::string &index_name);
+
     friend void
     check_param(int key, const std::string &table_name, std::vector<std::string> &actual_param);
 }; // class Table
 
+extern std::map<int, std::map<std::string, Table> > database; // все таблицы: <клиент, <имя таблицы, таблица>>
+
+
+/* ------------------------------------------------ */
+/* ------------------ TABLE VIEW ------------------ */
+/* ------------------------------------------------ */
 
 /**
- * [select_from_table: TODO добавить описание]
+ * [NB!] представление не копирует данные: оно ссылается на поля таблицы-источника
+ *       и действительно, пока таблица не удалена и не изменена
+ */
+class Table_view
+{
+private:
+    const Table *table = nullptr;                // таблица-источник
+    std::vector<std::string> column_names;       // имена выбранных полей по порядку
+    std::vector<const Table::Column *> columns;  // выбранные поля таблицы-источника
+    std::vector<size_t> rows;                    // номера выбранных строк (вектор выборки)
+
+    /**
+     * [write_row: appends to <out> the selected record <i> as one line of text]
+     */
+    void write_row(std::string &out, size_t i) const;
+
+public:
+    /**
+     * [constructor: default]
+     */
+    Table_view();
+
+    /**
+     * [size: returns the number of selected records]
+     */
+    size_t size() const;
+
+    /**
+     * [header: appends to <out> the name of the source table and the names of the selected fields]
+     */
+    void header(std::string &out) const;
+
+    /**
+     * [write_rows: appends to <out> the selected records one per line, starting from the record]
+     * [            <first>, until <out> reaches <limit> bytes; returns the next record to write]
+     * [            (<out> is one frame: it never grows beyond MAX_FRAME_SIZE, and a record    ]
+     * [            longer than a frame throws std::length_error)                              ]
+     */
+    size_t write_rows(std::string &out, size_t first, size_t limit) const;
+
+    /**
+     * [schema: appends to <out> the binary schema of the result (see protocol.h)]
+     */
+    void schema(std::string &out) const;
+
+    /**
+     * [write_batches: appends to <out> the selected records in binary batches (see protocol.h),]
+     * [               starting from the record <first>, until <out> reaches <limit> bytes;      ]
+     * [               returns the next record to write (<out> is one frame, as in write_rows()) ]
+     */
+    size_t write_batches(std::string &out, size_t first, size_t limit) const;
+
+    /**
+     * [to_string: represent selected records as string]
+     */
+    std::string to_string() const;
+
+    /**
+     * [clear: detach the view from the table]
+     */
+    void clear();
+
+    friend void
+    select_from_table(int key, const std::string &table_name, std::vector<std::string> &field_names,
+                      Where_condition &where,
+                      Table_view &selected_table);
+}; // class Table_view
+
+
+/* ------------------------------------------------ */
+/* ------------------ TABLE LOCK ------------------ */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] команда блокирует каталог <database> (совместно или монопольно) и затем
+ *       не более одной таблицы, всегда в этом порядке, поэтому взаимных блокировок нет;
+ *       блокировки держатся, пока результат команды (Table_view) не будет прочитан
+ */
+class Table_lock
+{
+public:
+    enum lock_mode
+    {
+        READ,   // чтение таблицы (SELECT)
+        WRITE,  // изменение записей таблицы (INSERT, UPDATE, DELETE)
+        CATALOG // изменение набора таблиц или индексов (CREATE, DROP)
+    }; // enum lock_mode
+
+    /**
+     * [lock: takes the locks needed to run a command of <mode> on the table <table_name> of <key>]
+     * [      (a missing table is not an error: the analyzer will report it)                     ]
+     */
+    void lock(int key, const std::string &table_name, lock_mode mode);
+
+    /**
+     * [unlock: releases all held locks]
+     */
+    void unlock();
+
+private:
+    std::shared_lock<std::shared_mutex> catalog_read;  // каталог: таблицы не создаются и не удаляются
+    std::unique_lock<std::shared_mutex> catalog_write; // каталог: монопольно
+    std::shared_lock<std::shared_mutex> table_read;    // таблица: совместно
+    std::unique_lock<std::shared_mutex> table_write;   // таблица: монопольно
+}; // class Table_lock
+
+
+/**
+ * [select_from_table: make <selected_table> a view of the fields <field_names> of the records]
+ * [                   of table <table_name> satisfying the condition <where>                 ]
+ * [                   (<field_names> == {"*"} means all fields in declaration order)   ]
  */
 void
 select_from_table(int key, const std::string &table_name, std::vector<std::string> &field_names, Where_condition &where,
-                  Table &selected_table);
+                  Table_view &selected_table);
 
 
 /**
- * [insert_into_table: insert a new entry <new_record> into the table <table_name>]
+ * [copy_into_table: appends to the table <table_name> all records of the CSV text <csv> (see csv.h)]
+ */
+void copy_into_table(int key, const std::string &table_name, std::string_view csv);
+
+/**
+ * [insert_into_table: insert new entries <new_record> (one after another) into the table <table_name>]
+ * [                   (all or none: an invalid value leaves the table unchanged)                     ]
  */
 void insert_into_table(int key, const std::string &table_name, std::vector<std::string> &new_record);
 
 
 /**
- * [update_table: assign a <new_value> to the fields <field_names> of table <table_name>]
+ * [update_table: assign the value of expression <new_value> to the field <column_name>]
+ * [              of the records of table <table_name> satisfying the condition <where>]
  */
-void update_table(int key, const std::string &table_name, std::string &column_name, const std::string &new_value,
+void update_table(int key, const std::string &table_name, std::string &column_name, Expression &new_value,
                   Where_condition &where);
 
 
 /**
- * [delete_table: remove from table <table_name> fields <field_names>]
+ * [delete_table: remove from table <table_name> the records satisfying the condition <where>]
+ * [              (records are only marked in the deletion bitmap; the columns are compacted]
+ * [              when deleted records make up a large enough part of the table)            ]
  */
 void delete_table(int key, const std::string &table_name, Where_condition &where);
 
@@ -171,6 +508,14 @@ void create_table(int key, const std::string &table_name, std::vector<std::pair<
 void drop_table(int key, const std::string &table_name);
 
 
+/**
+ * [create_index: create the index <index_name> on the field <column_name> of table <table_name>]
+ * [              <index_type>: "HASH" - hash index, "BTREE" - B+-tree (LONG fields only)      ]
+ */
+void create_index(int key, const std::string &index_name, const std::string &table_name,
+                  const std::string &column_name, const std::string &index_type);
+
+
 /**
 * [get_object_type: return the object_type by the <object_name> in table <table_name>]
 */
@@ -189,9 +534,15 @@ bool table_exist(int key, const std::string &table_name);
 bool object_exist(int key, const std::string &table_name, const std::string &object_name);
 
 
+/**
+ * [index_exist: return true, if an index <index_name> already exists in one of the tables]
+ */
+bool index_exist(int key, const std::string &index_name);
+
+
 /**
  * [check_param: check the conformity of the number and types of formal and actual felds]
- * [             of table <table_name>                                                  ]
+ * [             of table <table_name>; <actual_param> may hold several records in a row]
  */
 void check_param(int key, const std::string &table_name, std::vector<std::string> &actual_param);
 
@@ -0,0 +1,818 @@
+#include <iostream>   // std::cout
+#include <string>     // std::string
+#include <vector>     // std::vector
+#include <utility>    // std::pair
+#include <exception>  // std::exception
+#include <stdexcept>  // std::length_error
+#include <chrono>     // std::chrono::steady_clock
+#include <cstdint>    // int64_t, INT64_MIN, INT64_MAX
+#include <functional> // std::function
+#include <string_view> // std::string_view
+#include <filesystem> // std::filesystem: directory_iterator, resize_file(), remove_all()
+#include <fstream>    // std::ofstream
+#include <cstdio>     // std::remove()
+#include <cstdlib>    // mkdtemp()
+#include <unistd.h>   // symlink(), rmdir()
+#include <sys/stat.h> // mkdir()
+
+#include "../analyze.h"     // Analyze
+#include "../protocol.h"    // Binary_result, MAX_FRAME_SIZE
+#include "../compression.h" // Compressed_longs
+#include "../csv.h"         // parse_csv(), import_directory
+#include "../wal.h"         // Write_ahead_log
+#include "../mapped.h"      // Mapped_file
+
+/* ------------------------------------------------ */
+/* ------------------ REGRESSION ------------------ */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] каждый случай работает со своими таблицами (свой ключ сеанса), проверяет
+ *       ответ или ошибку команды и печатает PASS/FAIL; код возврата - число неудач
+ */
+
+static int failures = 0;
+
+
+/**
+ * [run: runs the <query> in the <session>; returns the result text or "ERROR: <message>"]
+ */
+static std::string run(Analyze &session, const std::string &query)
+{
+    std::string result;
+    try {
+        session.start(query);
+        result = session.get_table_text();
+    } catch (std::exception &error) {
+        result = std::string("ERROR: ") + error.what();
+    }
+    session.release();
+    return result;
+}
+
+
+/**
+ * [check: reports the case <name> as passed if <passed>, otherwise prints the <result>]
+ */
+static void check(const std::string &name, bool passed, const std::string &result = "")
+{
+    std::cout << (passed ? "PASS: " : "FAIL: ") << name << "\n";
+    if (!passed) {
+        std::cout << result << "\n";
+        ++failures;
+    }
+}
+
+
+static bool contains(const std::string &text, const std::string &part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+
+/**
+ * [count_rows: returns the number of rows in the text of a SELECT result]
+ */
+static size_t count_rows(const std::string &text)
+{
+    size_t rows = 0;
+    for (size_t line = 0; line < text.size(); line = text.find('\n', line) + 1) {
+        size_t colon = text.find(": ", line);
+        size_t end = text.find('\n', line);
+        if (colon != std::string::npos && colon < end && text.find_first_not_of("0123456789", line) == colon) {
+            ++rows;
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+    }
+    return rows;
+}
+
+
+/* -------------------- IN: константы другого типа -------------------- */
+
+static void in_list_types(int key, bool hash_index)
+{
+    Analyze session(key);
+    run(session, "CREATE TABLE t (a LONG, b TEXT);");
+    run(session, "INSERT INTO t VALUES (1, 'abc');");
+    run(session, "INSERT INTO t VALUES (2, 'x');");
+    if (hash_index) {
+        std::string result = run(session, "CREATE INDEX ia ON t (a) USING HASH;") +
+                             run(session, "CREATE INDEX ib ON t (b) USING HASH;");
+        check("hash indexes are created", !contains(result, "ERROR"), result);
+    }
+    const std::string suffix = hash_index ? " (hash index)" : "";
+    std::string result;
+
+    result = run(session, "SELECT * FROM t WHERE a IN ('abc');");
+    check("LONG IN (TEXT) is a type error" + suffix, contains(result, "type mismatch"), result);
+    result = run(session, "SELECT * FROM t WHERE a NOT IN ('abc');");
+    check("LONG NOT IN (TEXT) is a type error" + suffix, contains(result, "type mismatch"), result);
+    result = run(session, "SELECT * FROM t WHERE b IN (1);");
+    check("TEXT IN (LONG) is a type error" + suffix, contains(result, "type mismatch"), result);
+
+    result = run(session, "SELECT * FROM t WHERE a IN (2, 3);");
+    check("LONG IN (LONG) selects the matching rows" + suffix, count_rows(result) == 1, result);
+    result = run(session, "SELECT * FROM t WHERE b NOT IN ('x');");
+    check("TEXT NOT IN (TEXT) selects the other rows" + suffix, count_rows(result) == 1, result);
+}
+
+
+static void in_list_range(int key)
+{
+    Analyze session(key);
+    run(session, "CREATE TABLE t (a LONG);");
+    run(session, "INSERT INTO t VALUES (1);");
+    std::string result = run(session, "SELECT * FROM t WHERE a IN (99999999999999999999999);");
+    check("IN with an out-of-range constant is an error", contains(result, "does not fit into LONG"), result);
+    result = run(session, "INSERT INTO t VALUES (99999999999999999999999);");
+    check("INSERT of an out-of-range constant is an error", contains(result, "does not fit into LONG"), result);
+    result = run(session, "SELECT * FROM t WHERE a IN (9223372036854775807, 1);");
+    check("IN with the largest LONG constant works", count_rows(result) == 1, result);
+}
+
+
+/* -------------------- арифметика: переполнение -------------------- */
+
+static void arithmetic_overflow(int key)
+{
+    Analyze session(key);
+    run(session, "CREATE TABLE t (a LONG, b LONG);");
+    run(session, "INSERT INTO t VALUES (0, 9223372036854775807);");
+    std::string result = run(session, "UPDATE t SET a = 0 - 9223372036854775807 - 1 WHERE ALL;");
+    check("the smallest LONG can be computed", !contains(result, "ERROR"), result);
+
+    const char *queries[] = {
+            "SELECT * FROM t WHERE a / (0 - 1) = 0;",
+            "SELECT * FROM t WHERE a % (0 - 1) = 0;",
+            "SELECT * FROM t WHERE b + 1 = 0;",
+            "SELECT * FROM t WHERE a - 1 = 0;",
+            "SELECT * FROM t WHERE b * 2 = 0;",
+    };
+    for (const char *query : queries) {
+        result = run(session, query);
+        check(std::string("overflow is an error: ") + query, contains(result, "integer overflow"), result);
+    }
+    result = run(session, "SELECT * FROM t WHERE b / 0 = 0;");
+    check("division by zero is an error", contains(result, "division by zero"), result);
+}
+
+
+/* -------------------- UPDATE: всё или ничего -------------------- */
+
+static void partial_update(int key)
+{
+    Analyze session(key);
+    run(session, "CREATE TABLE u (a LONG, b TEXT);");
+    for (int i = 1; i <= 2000; ++i) {
+        run(session, "INSERT INTO u VALUES (" + std::to_string(i) + ", 'row " + std::to_string(i) + "');");
+    }
+    run(session, "CREATE INDEX ua ON u (a) USING HASH;");
+    const std::string before = run(session, "SELECT * FROM u WHERE ALL;");
+
+    // деление на ноль случается только в строке 1500, уже после первых пачек
+    std::string result = run(session, "UPDATE u SET a = 100 / (a - 1500) WHERE ALL;");
+    check("UPDATE with division by zero fails", contains(result, "division by zero"), result);
+    result = run(session, "SELECT * FROM u WHERE ALL;");
+    check("failed UPDATE leaves the table unchanged", result == before && count_rows(result) == 2000);
+    result = run(session, "SELECT * FROM u WHERE a = 1;");
+    check("failed UPDATE leaves the index unchanged", count_rows(result) == 1, result);
+
+    result = run(session, "UPDATE u SET a = a + 1 WHERE ALL;");
+    check("UPDATE of all rows succeeds", !contains(result, "ERROR"), result);
+    result = run(session, "SELECT * FROM u WHERE a = 2001;");
+    check("UPDATE changes the indexed values", count_rows(result) == 1, result);
+}
+
+
+/* -------------------- пустой запрос -------------------- */
+
+static void empty_query(int key)
+{
+    Analyze session(key);
+    std::string result = run(session, "");
+    check("empty query is an error", contains(result, "LEXICAL ERROR"), result);
+}
+
+
+/* -------------------- хеш-индекс: удаление многих строк одного значения -------------------- */
+
+/**
+ * [fill: creates the table <name> of <size> records with 4 distinct values in each field]
+ */
+static void fill(Analyze &session, int key, const std::string &name, size_t size)
+{
+    run(session, "CREATE TABLE " + name + " (a LONG, b TEXT);");
+    std::vector<std::string> records;
+    records.reserve(2 * size);
+    for (size_t i = 0; i < size; ++i) {
+        records.push_back(std::to_string(i % 4));
+        records.push_back("value " + std::to_string(i % 4));
+    }
+    insert_into_table(key, name, records);
+}
+
+
+/**
+ * [delete_time: returns the seconds taken by a DELETE of half the records of an indexed table]
+ */
+static double delete_time(Analyze &session, int key, size_t size)
+{
+    fill(session, key, "s", size);
+    run(session, "CREATE INDEX sa ON s (a) USING HASH;");
+    run(session, "CREATE INDEX sb ON s (b) USING HASH;");
+    auto start = std::chrono::steady_clock::now();
+    run(session, "DELETE FROM s WHERE a IN (0, 1);");
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - start;
+    run(session, "DROP TABLE s;");
+    return time.count();
+}
+
+
+static void index_erase(int key)
+{
+    Analyze session(key);
+    // одни и те же изменения в таблице с хеш-индексами и в таблице без индексов
+    fill(session, key, "h", 20000);
+    fill(session, key, "p", 20000);
+    run(session, "CREATE INDEX ha ON h (a) USING HASH;");
+    run(session, "CREATE INDEX hb ON h (b) USING HASH;");
+    for (const std::string name : {"h", "p"}) {
+        run(session, "DELETE FROM " + name + " WHERE a = 0;");
+        run(session, "UPDATE " + name + " SET b = 'value 9' WHERE a = 1;");
+        run(session, "UPDATE " + name + " SET a = 7 WHERE b = 'value 2';");
+    }
+    const char *conditions[] = {"a = 0", "a = 1", "a = 7", "a IN (3, 7)", "b = 'value 0'", "b = 'value 9'",
+                                "b = 'value 3'"};
+    for (const char *condition : conditions) {
+        std::string indexed = run(session, std::string("SELECT * FROM h WHERE ") + condition + ";");
+        std::string plain = run(session, std::string("SELECT * FROM p WHERE ") + condition + ";");
+        check(std::string("hash index after DELETE and UPDATE: ") + condition,
+              count_rows(indexed) == count_rows(plain) && count_rows(plain) % 5000 == 0, indexed);
+    }
+
+    // значения TEXT, исчезнувшие из индекса, копятся в его арене, пока она не будет переписана
+    run(session, "CREATE TABLE k (b TEXT, c TEXT, d TEXT);");
+    std::vector<std::string> records;
+    for (int i = 0; i < 20000; ++i) {
+        for (const char *field : {"b", "c", "d"}) {
+            records.push_back(std::string("a long enough value of ") + field + " number " + std::to_string(i));
+        }
+    }
+    insert_into_table(key, "k", records);
+    run(session, "CREATE INDEX kb ON k (b) USING HASH;");
+    run(session, "UPDATE k SET b = c WHERE ALL;");
+    run(session, "UPDATE k SET b = d WHERE ALL;");
+    std::string result = run(session, "SELECT * FROM k WHERE b = 'a long enough value of d number 12345';");
+    check("hash index on TEXT finds the values after its keys are repacked", count_rows(result) == 1, result);
+    result = run(session, "SELECT * FROM k WHERE b = 'a long enough value of c number 12345';");
+    check("hash index on TEXT forgets the replaced values", count_rows(result) == 0, result);
+
+    // удаление из списка строк одного значения линейно: вчетверо больше строк - не в 16 раз дольше
+    double small = delete_time(session, key, 20000);
+    double large = delete_time(session, key, 80000);
+    check("DELETE through a low-cardinality hash index is not quadratic", large < 8 * small + 0.01,
+          std::to_string(small) + " s / " + std::to_string(large) + " s");
+}
+
+
+/* -------------------- B+-дерево: диапазоны после вставок, удалений и перестроения -------------------- */
+
+/**
+ * [same_ranges: runs the range queries on the indexed table "o" and on the plain table "q";]
+ * [             returns the first query whose results differ or an empty string            ]
+ */
+static std::string same_ranges(Analyze &session)
+{
+    const char *conditions[] = {
+            "a >= 0", "a >= 500 AND a <= 520", "a > 497 AND a < 903", "a >= 899 AND a <= 1200", "a < 40",
+            "a > 1990", "a = 1000", "a = 600", "a >= 1999 AND a <= 1998", "a <= 0 - 9223372036854775807 - 1",
+            "a >= 9223372036854775807", "a > 0 - 9223372036854775807 - 1 AND a < 9223372036854775807",
+            "a >= 700 AND a <= 800 AND b < 2500",
+    };
+    for (const char *condition : conditions) {
+        std::string indexed = run(session, std::string("SELECT * FROM o WHERE ") + condition + ";");
+        std::string plain = run(session, std::string("SELECT * FROM q WHERE ") + condition + ";");
+        // ответы различаются только именем таблицы в заголовке
+        if (contains(plain, "ERROR") || indexed.find("--- COLUMNS") == std::string::npos ||
+            indexed.substr(indexed.find("--- COLUMNS")) != plain.substr(plain.find("--- COLUMNS"))) {
+            return std::string(condition) + "\n" + indexed + "\n" + plain;
+        }
+    }
+    return "";
+}
+
+
+static void btree_ranges(int key)
+{
+    Analyze session(key);
+    run(session, "CREATE TABLE o (a LONG, b LONG);");
+    run(session, "CREATE TABLE q (a LONG, b LONG);");
+    run(session, "CREATE INDEX oa ON o (a) USING BTREE;");
+
+    // ключи вразброс и с повторами: дерево растёт делением листьев и внутренних узлов
+    for (int batch = 0; batch < 50; ++batch) {
+        std::string values;
+        for (int i = batch * 100; i < (batch + 1) * 100; ++i) {
+            values += (values.empty() ? "(" : ", (") + std::to_string(i * 7919 % 2000) + ", " + std::to_string(i) + ")";
+        }
+        for (const std::string name : {"o", "q"}) {
+            run(session, "INSERT INTO " + name + " VALUES " + values + ";");
+        }
+    }
+    for (const std::string name : {"o", "q"}) {
+        run(session, "UPDATE " + name + " SET a = 0 - 9223372036854775807 - 1 WHERE b = 7;");
+        run(session, "UPDATE " + name + " SET a = 9223372036854775807 WHERE b = 8;");
+    }
+    std::string result = same_ranges(session);
+    check("B+-tree ranges across split nodes match a full scan", result.empty(), result);
+
+    // меньше четверти строк: таблица не уплотняется, опустевшие листья остаются в цепочке
+    for (const std::string name : {"o", "q"}) {
+        run(session, "DELETE FROM " + name + " WHERE a >= 500 AND a < 900;");
+        run(session, "UPDATE " + name + " SET a = a + 1000 WHERE a >= 100 AND a < 110;");
+    }
+    result = same_ranges(session);
+    check("B+-tree ranges over emptied leaves match a full scan", result.empty(), result);
+
+    // больше четверти строк: таблица уплотняется, дерево строится заново снизу вверх
+    for (const std::string name : {"o", "q"}) {
+        run(session, "DELETE FROM " + name + " WHERE a >= 1200 AND a < 1500;");
+    }
+    result = same_ranges(session);
+    check("B+-tree rebuilt after compaction matches a full scan", result.empty(), result);
+    for (const std::string name : {"o", "q"}) {
+        run(session, "INSERT INTO " + name + " VALUES (600, 9000), (1300, 9001), (1300, 9002), (1000, 9003);");
+    }
+    result = same_ranges(session);
+    check("B+-tree rebuilt after compaction takes new records", result.empty(), result);
+}
+
+
+/* -------------------- сжатие LONG: PACKED, DELTA, RLE -------------------- */
+
+/**
+ * [same_values: compares the reads of the <column> (operator[], gather, select) with the raw <values>;]
+ * [             returns the first difference or an empty string                                    ]
+ */
+static std::string same_values(const Compressed_longs &column, const std::vector<int64_t> &values)
+{
+    if (column.size() != values.size()) {
+        return "size " + std::to_string(column.size());
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (column[i] != values[i]) {
+            return "operator[] at " + std::to_string(i);
+        }
+    }
+    for (size_t stride : {1, 3, 1000}) {
+        std::vector<size_t> rows;
+        for (size_t i = stride / 2; i < values.size(); i += stride) {
+            rows.push_back(i);
+        }
+        std::vector<int64_t> out(rows.size());
+        column.gather(rows.data(), rows.size(), out.data());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (out[i] != values[rows[i]]) {
+                return "gather at " + std::to_string(rows[i]);
+            }
+        }
+
+        // границы у краёв LONG: разности с минимумом блока не помещаются в int64_t
+        const int64_t middle = values[values.size() / 2];
+        const std::pair<int64_t, int64_t> ranges[] = {
+                {INT64_MIN, INT64_MAX}, {INT64_MIN, INT64_MIN}, {INT64_MAX, INT64_MAX}, {INT64_MIN, middle},
+                {middle, INT64_MAX}, {middle, middle}, {-5, 5}, {1, 0},
+        };
+        for (const auto &range : ranges) {
+            for (bool inside : {true, false}) {
+                column.select(rows.data(), rows.size(), range.first, range.second, inside, out.data());
+                for (size_t i = 0; i < rows.size(); ++i) {
+                    const int64_t value = values[rows[i]];
+                    if (out[i] != ((range.first <= value && value <= range.second) == inside)) {
+                        return "select [" + std::to_string(range.first) + ", " + std::to_string(range.second) +
+                               "] at " + std::to_string(rows[i]);
+                    }
+                }
+            }
+        }
+    }
+    return "";
+}
+
+
+/**
+ * [compressed_block: fills a column with a full block of the values <shape>(i) and a part of the next]
+ * [                  block; checks the encoding of the full block and the reads                      ]
+ */
+static void compressed_block(const std::string &name, Compressed_longs::encoding kind,
+                             const std::function<int64_t(size_t)> &shape)
+{
+    Compressed_longs column;
+    std::vector<int64_t> values;
+    for (size_t i = 0; i < Compressed_longs::BLOCK_SIZE + 1000; ++i) {
+        values.push_back(shape(i % Compressed_longs::BLOCK_SIZE));
+        column.push_back(values.back());
+    }
+    check(name + ": the full block is encoded as expected", column.get_blocks()[0].kind == kind,
+          "encoding " + std::to_string(column.get_blocks()[0].kind));
+    std::string result = same_values(column, values);
+    check(name + ": reads match the raw values", result.empty(), result);
+
+    // изменённый блок хранится как есть до compress()
+    for (size_t row : {size_t(0), size_t(777), Compressed_longs::BLOCK_SIZE - 1, Compressed_longs::BLOCK_SIZE + 5}) {
+        values[row] = row % 2 == 0 ? INT64_MAX : INT64_MIN;
+        column.set(row, values[row]);
+    }
+    result = same_values(column, values);
+    check(name + ": reads after set() match the raw values", result.empty(), result);
+    column.compress();
+    result = same_values(column, values);
+    check(name + ": reads after compress() match the raw values", result.empty(), result);
+}
+
+
+static void compression()
+{
+    const size_t last = Compressed_longs::BLOCK_SIZE - 1;
+    compressed_block("PACKED near INT64_MIN", Compressed_longs::PACKED,
+                     [](size_t i) { return INT64_MIN + int64_t(i * 7919 % 1000); });
+    compressed_block("PACKED near INT64_MAX", Compressed_longs::PACKED,
+                     [](size_t i) { return INT64_MAX - int64_t(i * 7919 % 1000); });
+    // разность наибольшего и наименьшего значений не помещается в int64_t
+    compressed_block("PACKED over 63 bits", Compressed_longs::PACKED,
+                     [](size_t i) { return i % 3 == 0 ? INT64_MIN : i % 3 == 1 ? int64_t(-1) : -int64_t(i) - 2; });
+    compressed_block("DELTA ascending with jitter", Compressed_longs::DELTA,
+                     [](size_t i) { return int64_t(3 * i + i % 2); });
+    // шаг 2^47: прямая проходит почти от INT64_MIN до INT64_MAX
+    compressed_block("DELTA across the whole LONG range", Compressed_longs::DELTA,
+                     [](size_t i) { return INT64_MIN + int64_t(i) * (int64_t(1) << 47) + int64_t(i % 3); });
+    compressed_block("DELTA descending to INT64_MIN", Compressed_longs::DELTA,
+                     [last](size_t i) { return INT64_MIN + int64_t(last - i) * 1000 + int64_t(i % 2); });
+    compressed_block("RLE of the LONG edges", Compressed_longs::RLE, [](size_t i) {
+        const int64_t values[] = {INT64_MIN, INT64_MAX, 0};
+        return values[i / 1000 % 3];
+    });
+
+    // UPDATE нарушает монотонность: блок больше не сжимается как DELTA
+    Compressed_longs column;
+    std::vector<int64_t> values;
+    for (size_t i = 0; i < Compressed_longs::BLOCK_SIZE; ++i) {
+        values.push_back(int64_t(10 * i));
+        column.push_back(values.back());
+    }
+    values[30000] = 0;
+    column.set(30000, 0);
+    column.compress();
+    const Compressed_longs::Block &block = column.get_blocks()[0];
+    check("DELTA is not chosen for a block that is no longer monotonic",
+          block.kind != Compressed_longs::DELTA && block.sealed, "encoding " + std::to_string(block.kind));
+    std::string result = same_values(column, values);
+    check("reads of the block recompressed after UPDATE match the raw values", result.empty(), result);
+}
+
+
+/* -------------------- CSV и COPY -------------------- */
+
+/**
+ * [csv_error: returns the message of the error thrown by parse_csv() on the <data> or an empty string]
+ */
+static std::string csv_error(const std::string &data, size_t threads)
+{
+    try {
+        parse_csv(data, {LONG, TEXT}, threads);
+    } catch (std::exception &error) {
+        return error.what();
+    }
+    return "";
+}
+
+
+static void csv_parsing()
+{
+    std::vector<Csv_chunk> chunks = parse_csv("1,\"a, b\"\r\n2,\"say \"\"hi\"\"\"\r\n\r\n3,plain\n4,\"\"\n",
+                                              {LONG, TEXT}, 4);
+    bool same = chunks.size() == 1 && chunks[0].rows == 4 && chunks[0].lines == 5;
+    const std::vector<std::string> texts = {"a, b", "say \"hi\"", "plain", ""};
+    for (size_t i = 0; same && i < texts.size(); ++i) {
+        same = chunks[0].columns[0].longs[i] == int64_t(i + 1) && chunks[0].columns[1].texts[i] == texts[i];
+    }
+    check("CSV quotes, doubled quotes, CRLF and empty lines", same);
+
+    const std::pair<const char *, const char *> errors[] = {
+            {"1,\"abc\n", "line 1: broken quotes in field 2"},
+            {"1,\"a\"b\n", "line 1: broken quotes in field 2"},
+            {"1,a\r\n\r\nx,b\r\n", "line 3: bad LONG value 'x' in field 1"},
+            {"1,a,b\n", "line 1: expected 2 fields"},
+            {"1\n", "line 1: expected 2 fields"},
+    };
+    for (const auto &error : errors) {
+        std::string result = csv_error(error.first, 1);
+        check(std::string("CSV error: ") + error.second, result == error.second, result);
+    }
+
+    // больше трёх МиБ: файл делится на части, номера строк и значения идут через их границы
+    std::string data;
+    size_t lines = 0, rows = 0;
+    while (data.size() < (7u << 19)) {
+        data += std::to_string(rows) + ",\"line \"\"" + std::to_string(rows) + "\"\"\"" + (rows % 2 ? "\r\n" : "\n");
+        ++rows;
+        ++lines;
+        if (rows % 1000 == 0) {
+            data += "\n";
+            ++lines;
+        }
+    }
+    chunks = parse_csv(data, {LONG, TEXT}, 4);
+    size_t row = 0;
+    same = chunks.size() == 3;
+    for (const auto &chunk : chunks) {
+        for (size_t i = 0; same && i < chunk.rows; ++i, ++row) {
+            same = chunk.columns[0].longs[i] == int64_t(row) &&
+                   chunk.columns[1].texts[i] == "line \"" + std::to_string(row) + "\"";
+        }
+    }
+    check("CSV parts parsed in parallel keep all the records in order", same && row == rows);
+    for (size_t bad : {size_t(1), lines / 2, lines - 1}) {
+        // портим строку <bad>: ищем её начало, отсчитывая переводы строк
+        std::string broken = data;
+        size_t start = 0;
+        for (size_t line = 1; line < bad; ++line) {
+            start = broken.find('\n', start) + 1;
+        }
+        broken.insert(start, "x");
+        std::string result = csv_error(broken, 4);
+        check("CSV error line number across parts: line " + std::to_string(bad),
+              result.compare(0, result.find(':'), "line " + std::to_string(bad)) == 0, result);
+    }
+}
+
+
+static void copy_paths(int key)
+{
+    Analyze session(key);
+    run(session, "CREATE TABLE c (a LONG, b TEXT);");
+    char base[] = "/tmp/copy_pathsXXXXXX";
+    const std::string root = mkdtemp(base);
+    const std::string directory = root + "/import";
+    mkdir(directory.c_str(), 0700);
+    std::ofstream(directory + "/in.csv") << "1,one\n2,two\n";
+    std::ofstream(root + "/out.csv") << "3,three\n";
+    symlink((root + "/out.csv").c_str(), (directory + "/link.csv").c_str());
+
+    import_directory = "";
+    std::string result = run(session, "COPY c FROM 'in.csv';");
+    check("COPY without an import directory is an error", contains(result, "disabled"), result);
+
+    import_directory = directory;
+    result = run(session, "COPY c FROM 'in.csv';") + run(session, "COPY c FROM './../import/in.csv';") +
+             run(session, "COPY c FROM '" + directory + "/in.csv';");
+    check("COPY reads files in the import directory", !contains(result, "ERROR"), result);
+    const std::string outside[] = {"../out.csv", root + "/out.csv", "link.csv", "/etc/passwd", "."};
+    for (const std::string &name : outside) {
+        result = run(session, "COPY c FROM '" + name + "';");
+        check("COPY rejects a file outside the import directory: " + name, contains(result, "outside"), result);
+    }
+    result = run(session, "COPY c FROM 'missing.csv';");
+    check("COPY of a missing file is an error", contains(result, "can't open file"), result);
+    result = run(session, "SELECT * FROM c WHERE ALL;");
+    check("only the files in the import directory are copied", count_rows(result) == 6, result);
+
+    // полей больше, чем потоков: каждый поток дописывает несколько полей
+    std::string columns, line;
+    for (int col = 0; col < 100; ++col) {
+        columns += (col == 0 ? "c" : ", c") + std::to_string(col) + " LONG";
+        line += (col == 0 ? "" : ",") + std::to_string(col);
+    }
+    run(session, "CREATE TABLE wide (" + columns + ");");
+    std::ofstream(directory + "/wide.csv") << line << "\n" << line << "\n";
+    result = run(session, "COPY wide FROM 'wide.csv';");
+    check("COPY into a table with more fields than threads", !contains(result, "ERROR"), result);
+    result = run(session, "SELECT * FROM wide WHERE c99 = 99;");
+    check("all the fields of a wide table are copied", count_rows(result) == 2, result);
+    std::remove((directory + "/wide.csv").c_str());
+
+    import_directory = "";
+    std::remove((directory + "/link.csv").c_str());
+    std::remove((directory + "/in.csv").c_str());
+    std::remove((root + "/out.csv").c_str());
+    rmdir(directory.c_str());
+    rmdir(root.c_str());
+}
+
+
+/* -------------------- размер кадра -------------------- */
+
+/**
+ * [frames: splits the selected <view> into frames like the server does; returns false if a frame]
+ * [        is longer than MAX_FRAME_SIZE; the binary frames are decoded into <result>           ]
+ */
+static bool frames(const Table_view &view, bool binary, Binary_result &result, size_t &count)
+{
+    std::string chunk;
+    if (binary) {
+        view.schema(chunk);
+    } else {
+        view.header(chunk);
+    }
+    bool fits = true;
+    size_t row = 0;
+    count = 0;
+    do {
+        row = binary ? view.write_batches(chunk, row, 65536) : view.write_rows(chunk, row, 65536);
+        fits = fits && chunk.size() <= MAX_FRAME_SIZE;
+        if (binary) {
+            result.read(chunk);
+        }
+        chunk.clear();
+        ++count;
+    } while (row < view.size());
+    return fits;
+}
+
+
+static void frame_size(int key)
+{
+    Analyze session(key);
+    run(session, "CREATE TABLE f (a LONG, b TEXT);");
+    // пять значений по 20 МиБ: вместе с соседями по пачке они не помещаются в один кадр
+    std::vector<std::string> records;
+    for (int i = 0; i < 5; ++i) {
+        records.push_back(std::to_string(i));
+        records.push_back(std::string(20u << 20, char('a' + i)));
+        records.push_back(std::to_string(100 + i));
+        records.push_back("short");
+    }
+    insert_into_table(key, "f", records);
+
+    session.start("SELECT * FROM f WHERE ALL;");
+    Binary_result result;
+    size_t count = 0;
+    bool fits = frames(*session.get_table_view(), true, result, count);
+    check("binary frames stay within MAX_FRAME_SIZE", fits && count > 1);
+    bool same = result.rows == 10 && result.columns.size() == 2;
+    for (size_t i = 0; same && i < 10; ++i) {
+        same = result.columns[0].longs[i] == (i % 2 == 0 ? int64_t(i / 2) : int64_t(100 + i / 2)) &&
+               result.columns[1].texts[i].size() == (i % 2 == 0 ? (20u << 20) : 5);
+    }
+    check("binary frames decode to the selected records", same);
+    fits = frames(*session.get_table_view(), false, result, count);
+    check("text frames stay within MAX_FRAME_SIZE", fits && count > 1);
+    session.release();
+
+    // значение длиннее кадра отправить нельзя: это ошибка, а не испорченный кадр
+    records = {"5", std::string(MAX_FRAME_SIZE + 1, 'z')};
+    insert_into_table(key, "f", records);
+    session.start("SELECT * FROM f WHERE a = 5;");
+    for (bool binary : {true, false}) {
+        bool thrown = false;
+        try {
+            frames(*session.get_table_view(), binary, result, count);
+        } catch (std::length_error &) {
+            thrown = true;
+        }
+        check(std::string("a value longer than a frame is rejected") + (binary ? " (binary)" : " (text)"), thrown);
+    }
+    session.release();
+    run(session, "DROP TABLE f;");
+}
+
+
+/* -------------------- журнал: всё или ничего, COPY с данными -------------------- */
+
+static void logged_changes(int key)
+{
+    Analyze session(key);
+    run(session, "CREATE TABLE w (a LONG, b TEXT);");
+    std::string result = run(session, "INSERT INTO w VALUES (1, 'one'), (99999999999999999999, 'two');");
+    check("INSERT with an invalid value fails", contains(result, "does not fit into LONG"), result);
+    result = run(session, "SELECT * FROM w WHERE ALL;");
+    check("failed INSERT leaves the table unchanged", count_rows(result) == 0, result);
+
+    // запись журнала COPY повторяется без файла
+    session.replay("COPY w FROM DATA;\n1,one\n2,\"two, three\"\n");
+    result = run(session, "SELECT * FROM w WHERE b = 'two, three';");
+    check("replayed COPY appends the logged records", count_rows(result) == 1, result);
+    session.replay("INSERT INTO w VALUES (3, 'three');");
+    result = run(session, "SELECT * FROM w WHERE ALL;");
+    check("replayed commands run as usual", count_rows(result) == 3, result);
+    bool thrown = false;
+    try {
+        session.replay("COPY missing FROM DATA;\n1,one\n");
+    } catch (std::exception &) {
+        thrown = true;
+    }
+    check("replay of a COPY into a missing table fails", thrown);
+}
+
+
+/* -------------------- журнал: данные COPY в своём файле -------------------- */
+
+/**
+ * [data_files: returns the number of the log data files next to the log <name>]
+ */
+static size_t data_files(const std::string &name)
+{
+    size_t count = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(std::filesystem::path(name).parent_path())) {
+        count += entry.path().filename().string().compare(0, 9, "wal.data.") == 0;
+    }
+    return count;
+}
+
+
+static void log_data_files()
+{
+    char base[] = "/tmp/log_data_filesXXXXXX";
+    const std::string root = mkdtemp(base);
+    const std::string name = root + "/wal";
+    const std::string small = "1,one\n", large(Write_ahead_log::INLINE_DATA_SIZE + 1000, 'x');
+    std::vector<std::pair<std::string, std::string>> replayed;
+    auto collect = [&replayed](std::string_view command, std::string_view data) {
+        replayed.emplace_back(command, data);
+    };
+    const std::chrono::microseconds interval(100);
+
+    {
+        Write_ahead_log log;
+        log.open(name, 0, collect, interval, 1u << 20);
+        log.append("INSERT INTO t VALUES (1);");
+        log.append("COPY t FROM DATA;\n", small);
+        log.wait(log.append("COPY t FROM DATA;\n", large));
+    }
+    check("large COPY data is written to a log data file", data_files(name) == 1);
+    {
+        Write_ahead_log log;
+        log.open(name, 0, collect, interval, 1u << 20);
+        check("log records with inline data and with a data file are replayed",
+              replayed.size() == 3 && replayed[0].first == "INSERT INTO t VALUES (1);" && replayed[0].second.empty() &&
+              replayed[1].first == "COPY t FROM DATA;\n" + small && replayed[1].second.empty() &&
+              replayed[2].first == "COPY t FROM DATA;\n" && replayed[2].second == large);
+        const uint64_t lsn = log.rotate(); // контрольная точка всех трёх записей
+        log.remove_segments(lsn);
+        check("a checkpoint removes the log data files of its records", data_files(name) == 0);
+        log.wait(log.append("COPY t FROM DATA;\n", large));
+    }
+
+    // файл данных без записи (сбой до неё) удаляется, испорченный файл записи -- ошибка повтора
+    std::ofstream(name + ".data.99") << "orphan";
+    replayed.clear();
+    {
+        Write_ahead_log log;
+        log.open(name, 3, collect, interval, 1u << 20);
+        check("a log data file without a record is removed", data_files(name) == 1 && replayed.size() == 1);
+    }
+    for (const auto &entry : std::filesystem::directory_iterator(root)) {
+        if (entry.path().filename().string().compare(0, 9, "wal.data.") == 0) {
+            std::filesystem::resize_file(entry.path(), 10);
+        }
+    }
+    bool thrown = false;
+    try {
+        Write_ahead_log log;
+        log.open(name, 3, collect, interval, 1u << 20);
+    } catch (std::runtime_error &error) {
+        thrown = contains(error.what(), "damaged");
+    }
+    check("replay of a record with a damaged data file fails", thrown);
+
+    // закрытый журнал ничего не проверяет и не копирует: COPY файла длиннее 4 ГиБ возможен
+    std::ofstream(root + "/huge");
+    std::filesystem::resize_file(root + "/huge", (uint64_t(1) << 32) + 1);
+    {
+        Mapped_file huge(root + "/huge");
+        Write_ahead_log log;
+        thrown = false;
+        try {
+            thrown = log.append("COPY t FROM DATA;\n", huge.data()) != 0;
+        } catch (std::exception &) {
+            thrown = true;
+        }
+        check("a closed log takes a record of any length", !thrown);
+    }
+    std::filesystem::remove_all(root);
+}
+
+
+int main()
+{
+    in_list_types(1, false);
+    in_list_types(2, true);
+    in_list_range(3);
+    arithmetic_overflow(4);
+    partial_update(5);
+    empty_query(6);
+    frame_size(7);
+    logged_changes(8);
+    index_erase(9);
+    btree_ranges(10);
+    compression();
+    csv_parsing();
+    copy_paths(11);
+    log_data_files();
+
+    std::cout << (failures == 0 ? "all cases passed" : std::to_string(failures) + " case(s) failed") << "\n";
+    return failures == 0 ? 0 : 1;
+}
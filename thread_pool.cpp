@@ -0,0 +1,58 @@
+#include <cstddef>    // size_t
+#include <functional> // std::function
+#include <utility>    // std::move()
+#include <mutex>      // std::unique_lock, std::lock_guard
+
+#include "thread_pool.h" // прототипы всех функций, описанных в этом файле
+
+
+/* -------------------- class Thread_pool -------------------- */
+
+Thread_pool::Thread_pool(size_t threads)
+{
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&Thread_pool::work, this);
+    }
+}
+
+
+Thread_pool::~Thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+
+void Thread_pool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        tasks.push(std::move(task));
+    }
+    ready.notify_one();
+}
+
+
+void Thread_pool::work()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(mutex);
+            ready.wait(guard, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) { // пул останавливается и задач не осталось
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task(); // выполняем без блокировки очереди
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef SQL_INTERPRETER_THREAD_POOL_H
+#define SQL_INTERPRETER_THREAD_POOL_H
+
+#include <cstddef>            // size_t
+#include <functional>         // std::function
+#include <vector>             // std::vector
+#include <queue>              // std::queue
+#include <thread>             // std::thread
+#include <mutex>              // std::mutex
+#include <condition_variable> // std::condition_variable
+
+/* ------------------------------------------------ */
+/* ----------------- THREAD POOL ------------------ */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] задачи выполняются в порядке поступления, но параллельно на нескольких потоках:
+ *       порядок команд одного клиента соблюдает сам сервер (у клиента не больше одной задачи)
+ */
+class Thread_pool
+{
+public:
+    /**
+     * [constructor: starts <threads> worker threads]
+     */
+    explicit Thread_pool(size_t threads);
+
+    /**
+     * [destructor: finishes the queued tasks and joins the workers]
+     */
+    ~Thread_pool();
+
+    Thread_pool(const Thread_pool &) = delete;
+    Thread_pool &operator=(const Thread_pool &) = delete;
+
+    /**
+     * [submit: queues the <task> for execution on one of the workers]
+     */
+    void submit(std::function<void()> task);
+
+private:
+    std::vector<std::thread> workers;        // рабочие потоки
+    std::queue<std::function<void()>> tasks; // задачи, ждущие свободного потока
+    std::mutex mutex;                        // защищает <tasks> и <stopping>
+    std::condition_variable ready;           // появилась задача или пул останавливается
+    bool stopping = false;
+
+    /**
+     * [work: the loop of a worker thread]
+     */
+    void work();
+}; // class Thread_pool
+
+#endif // SQL_INTERPRETER_THREAD_POOL_H
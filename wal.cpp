@@ -0,0 +1,452 @@
+#include <cstddef>            // size_t
+#include <cstdint>            // uint32_t, uint64_t
+#include <cstring>            // memcpy()
+#include <cstdlib>            // std::abort()
+#include <iostream>           // std::cerr, std::endl
+#include <string>             // std::string: append(), swap()
+#include <string_view>        // std::string_view
+#include <functional>         // std::function
+#include <vector>             // std::vector
+#include <array>              // std::array
+#include <algorithm>          // std::sort(), std::max(), std::none_of()
+#include <filesystem>         // std::filesystem: directory_iterator, rename(), remove(), file_size()
+#include <utility>            // std::pair, std::move()
+#include <chrono>             // std::chrono::microseconds
+#include <mutex>              // std::unique_lock, std::lock_guard
+#include <stdexcept>          // std::runtime_error, std::length_error
+#include <fcntl.h>            // open()
+#include <unistd.h>           // write(), fsync(), fdatasync(), ftruncate(), close()
+
+#include "wal.h"    // прототипы всех функций, описанных в этом файле
+#include "mapped.h" // Mapped_file
+
+
+Write_ahead_log wal;
+
+const size_t RECORD_HEADER_SIZE = sizeof(uint64_t) + 2 * sizeof(uint32_t); // номер, длина, CRC32
+const size_t DATA_REFERENCE_SIZE = 2 * sizeof(uint64_t) + sizeof(uint32_t); // номер файла, длина, CRC32 данных
+
+
+/**
+ * [crc32: returns the CRC-32 (IEEE) of <size> bytes at <data>, continuing from <crc>]
+ */
+static uint32_t crc32(const char *data, size_t size, uint32_t crc = 0)
+{
+    // таблица строится один раз, при первом вызове
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> result{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+            result[i] = value;
+        }
+        return result;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/**
+ * [record_crc: returns the checksum of the record <lsn> with the <command> followed by the <data>]
+ * [            (<in_file>: the record refers to a data file)                                    ]
+ */
+static uint32_t record_crc(uint64_t lsn, std::string_view command, std::string_view data = std::string_view(),
+                           bool in_file = false)
+{
+    uint32_t size = (command.size() + data.size()) | (in_file ? Write_ahead_log::DATA_FILE : 0);
+    uint32_t crc = crc32(reinterpret_cast<const char *>(&lsn), sizeof(lsn));
+    crc = crc32(reinterpret_cast<const char *>(&size), sizeof(size), crc);
+    crc = crc32(command.data(), command.size(), crc);
+    return crc32(data.data(), data.size(), crc);
+}
+
+/**
+ * [write_all: writes <data> to <fd> completely; aborts the server if the disk fails]
+ */
+static void write_all(int fd, std::string_view data)
+{
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t bytes = ::write(fd, data.data() + done, data.size() - done);
+        if (bytes == -1) {
+            // подтверждённые клиентам изменения уже не попадут на диск: продолжать нельзя
+            std::cerr << "Can't write the log! Quitting" << std::endl;
+            std::abort();
+        }
+        done += bytes;
+    }
+}
+
+
+/**
+ * [put: appends the bytes of <value> to <out>]
+ */
+template <class Value>
+static void put(std::string &out, Value value)
+{
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/**
+ * [segments: returns the files <file_name><suffix><number> (by default the previous log files]
+ * [          <file_name>.<LSN>) sorted by number                                             ]
+ */
+static std::vector<std::pair<uint64_t, std::filesystem::path>> segments(const std::string &file_name,
+                                                                        const std::string &suffix = ".")
+{
+    std::vector<std::pair<uint64_t, std::filesystem::path>> result;
+    const std::filesystem::path path(file_name);
+    const std::string prefix = path.filename().string() + suffix;
+    std::filesystem::path directory = path.parent_path().empty() ? "." : path.parent_path();
+    for (const auto &entry : std::filesystem::directory_iterator(directory)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0 &&
+            name.find_first_not_of("0123456789", prefix.size()) == std::string::npos) {
+            result.emplace_back(std::stoull(name.substr(prefix.size())), entry.path());
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+/**
+ * [sync_directory: waits until the renames in the <directory> reach the disk]
+ */
+static void sync_directory(const std::string &directory)
+{
+    int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+
+/* -------------------- class Write_ahead_log -------------------- */
+
+Write_ahead_log::~Write_ahead_log()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    pending.notify_all();
+    durable.notify_all();
+    if (flusher.joinable()) {
+        flusher.join(); // поток допишет остаток буфера
+    }
+    waiters.clear(); // сервер остановлен: отвечать уже некому
+    if (fd != -1) {
+        close(fd);
+    }
+}
+
+
+size_t Write_ahead_log::replay(const std::string &file, const std::string &log_name, uint64_t checkpoint_lsn,
+                              const std::function<void(std::string_view, std::string_view)> &apply,
+                              uint64_t &previous, uint64_t &last)
+{
+    Mapped_file log(file);
+    std::string_view data = log.data();
+    size_t valid = 0;
+    while (data.size() - valid >= RECORD_HEADER_SIZE) {
+        uint64_t lsn;
+        uint32_t size, crc;
+        memcpy(&lsn, data.data() + valid, sizeof(lsn));
+        memcpy(&size, data.data() + valid + sizeof(lsn), sizeof(size));
+        memcpy(&crc, data.data() + valid + sizeof(lsn) + sizeof(size), sizeof(crc));
+        const bool in_file = (size & DATA_FILE) != 0;
+        size &= ~DATA_FILE;
+        if (data.size() - valid - RECORD_HEADER_SIZE < size || lsn <= previous ||
+            (in_file && size < DATA_REFERENCE_SIZE)) {
+            break;
+        }
+        std::string_view command = data.substr(valid + RECORD_HEADER_SIZE, size);
+        if (record_crc(lsn, command, std::string_view(), in_file) != crc) {
+            break;
+        }
+        if (lsn > checkpoint_lsn && !in_file) {
+            apply(command, std::string_view());
+            last = lsn;
+        } else if (lsn > checkpoint_lsn) {
+            // запись цела, значит, её файл данных дошёл до диска раньше неё
+            uint64_t number, data_size;
+            uint32_t data_crc;
+            const char *reference = command.data() + command.size() - DATA_REFERENCE_SIZE;
+            memcpy(&number, reference, sizeof(number));
+            memcpy(&data_size, reference + sizeof(number), sizeof(data_size));
+            memcpy(&data_crc, reference + sizeof(number) + sizeof(data_size), sizeof(data_crc));
+            const std::string data_name = log_name + ".data." + std::to_string(number);
+            Mapped_file data_file(data_name, true);
+            if (data_file.data().size() != data_size ||
+                crc32(data_file.data().data(), data_file.data().size()) != data_crc) {
+                throw std::runtime_error("log data file " + data_name + " is damaged");
+            }
+            data_files.emplace_back(lsn, data_name);
+            command.remove_suffix(DATA_REFERENCE_SIZE);
+            apply(command, data_file.data());
+            last = lsn;
+        }
+        previous = lsn;
+        valid += RECORD_HEADER_SIZE + size;
+    }
+    return valid;
+}
+
+
+void Write_ahead_log::open(const std::string &file_name, uint64_t checkpoint_lsn,
+                           const std::function<void(std::string_view, std::string_view)> &apply,
+                           std::chrono::microseconds interval, size_t flush_size)
+{
+    int file = ::open(file_name.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (file == -1) {
+        throw std::runtime_error("can't open log " + file_name);
+    }
+
+    // повторяем записи новее контрольной точки: сначала из прежних файлов, затем из текущего
+    uint64_t previous = 0, last = checkpoint_lsn;
+    size_t valid = 0;
+    try {
+        for (const auto &segment : segments(file_name)) {
+            const std::string name = segment.second.string();
+            if (replay(name, file_name, checkpoint_lsn, apply, previous, last) !=
+                std::filesystem::file_size(segment.second)) {
+                throw std::runtime_error("log " + name + " is damaged"); // прежние файлы дописаны целиком
+            }
+        }
+        // хвост текущего файла, оборванный сбоем, отбрасываем
+        valid = replay(file_name, file_name, checkpoint_lsn, apply, previous, last);
+        if (valid < std::filesystem::file_size(file_name) && (ftruncate(file, valid) == -1 || fsync(file) == -1)) {
+            throw std::runtime_error("can't repair log " + file_name);
+        }
+    }
+    catch (...) {
+        close(file);
+        throw;
+    }
+
+    std::lock_guard<std::mutex> guard(mutex);
+    this->file_name = file_name;
+    fd = file;
+    file_size = valid;
+    next_lsn = std::max(last, previous) + 1;
+    durable_lsn = next_lsn - 1;
+    this->interval = interval;
+    this->flush_size = flush_size;
+    flusher = std::thread(&Write_ahead_log::flush, this);
+    for (const auto &segment : segments(file_name)) {
+        if (segment.first <= checkpoint_lsn) {
+            std::filesystem::remove(segment.second); // точка дописана, а сервер упал до их удаления
+        }
+    }
+    // файлы данных, на которые не ссылается ни одна повторённая запись: их записи старше точки
+    // или не попали в журнал до сбоя
+    for (const auto &segment : segments(file_name, ".data.")) {
+        next_data = std::max(next_data, segment.first + 1);
+        if (std::none_of(data_files.begin(), data_files.end(),
+                         [&segment](const auto &file) { return file.second == segment.second.string(); })) {
+            std::filesystem::remove(segment.second);
+        }
+    }
+}
+
+
+uint64_t Write_ahead_log::append(std::string_view command, std::string_view data)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (fd == -1) {
+        return 0; // журнала нет: данные не проверяются и не копируются
+    }
+    if (data.size() > INLINE_DATA_SIZE) {
+        lock.unlock(); // файл данных пишется без блокировки журнала
+        return append_file(command, data);
+    }
+    if (command.size() + data.size() > MAX_RECORD_SIZE) {
+        throw std::length_error("the log record is too long");
+    }
+    uint64_t lsn = next_lsn++;
+    put<uint64_t>(buffer, lsn);
+    put<uint32_t>(buffer, command.size() + data.size());
+    put<uint32_t>(buffer, record_crc(lsn, command, data));
+    buffer.append(command);
+    buffer.append(data);
+    pending.notify_one();
+    return lsn;
+}
+
+
+uint64_t Write_ahead_log::append_file(std::string_view command, std::string_view data)
+{
+    if (command.size() + DATA_REFERENCE_SIZE > MAX_RECORD_SIZE) {
+        throw std::length_error("the log record is too long");
+    }
+    uint64_t number;
+    std::string data_name;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        number = next_data++;
+        data_name = file_name + ".data." + std::to_string(number);
+    }
+    // данные и имя файла доходят до диска раньше записи, которая на них ссылается
+    int file = ::open(data_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file == -1) {
+        throw std::runtime_error("can't create log data file " + data_name);
+    }
+    write_all(file, data);
+    if (fdatasync(file) == -1) {
+        std::cerr << "Can't sync the log! Quitting" << std::endl;
+        std::abort();
+    }
+    close(file);
+    sync_directory(std::filesystem::path(data_name).parent_path().string());
+
+    std::string record(command);
+    put<uint64_t>(record, number);
+    put<uint64_t>(record, data.size());
+    put<uint32_t>(record, crc32(data.data(), data.size()));
+
+    std::lock_guard<std::mutex> guard(mutex);
+    uint64_t lsn = next_lsn++;
+    put<uint64_t>(buffer, lsn);
+    put<uint32_t>(buffer, record.size() | DATA_FILE);
+    put<uint32_t>(buffer, record_crc(lsn, record, std::string_view(), true));
+    buffer.append(record);
+    data_files.emplace_back(lsn, data_name);
+    pending.notify_one();
+    return lsn;
+}
+
+
+void Write_ahead_log::wait(uint64_t lsn)
+{
+    if (lsn == 0) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    durable.wait(lock, [this, lsn] { return durable_lsn >= lsn || stopping; });
+}
+
+
+void Write_ahead_log::when_durable(uint64_t lsn, std::function<void()> done)
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (lsn > durable_lsn && !stopping) {
+            waiters.emplace_back(lsn, std::move(done));
+            return;
+        }
+    }
+    done();
+}
+
+
+std::vector<std::function<void()>> Write_ahead_log::take_durable()
+{
+    std::vector<std::function<void()>> ready;
+    size_t kept = 0;
+    for (auto &waiter : waiters) {
+        if (waiter.first <= durable_lsn) {
+            ready.push_back(std::move(waiter.second));
+        } else {
+            waiters[kept++] = std::move(waiter);
+        }
+    }
+    waiters.resize(kept);
+    return ready;
+}
+
+
+uint64_t Write_ahead_log::last_lsn()
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    return next_lsn - 1;
+}
+
+
+uint64_t Write_ahead_log::rotate()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    const uint64_t lsn = next_lsn - 1;
+    if (fd == -1) {
+        return lsn;
+    }
+    durable.wait(lock, [this] { return !flushing; });
+    if (file_size == 0) {
+        return lsn; // в текущем файле нет записей: прежний файл с тем же <lsn> не затираем
+    }
+    // записи из буфера (не новее <lsn>) уйдут уже в новый файл: при повторе они пропускаются
+    std::filesystem::rename(file_name, file_name + "." + std::to_string(lsn));
+    int file = ::open(file_name.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (file == -1) {
+        throw std::runtime_error("can't create log " + file_name);
+    }
+    sync_directory(std::filesystem::path(file_name).parent_path().string());
+    close(fd);
+    fd = file;
+    file_size = 0;
+    return lsn;
+}
+
+
+void Write_ahead_log::remove_segments(uint64_t lsn)
+{
+    std::lock_guard<std::mutex> guard(mutex);
+    if (fd == -1) {
+        return;
+    }
+    for (const auto &segment : segments(file_name)) {
+        if (segment.first <= lsn) {
+            std::filesystem::remove(segment.second);
+        }
+    }
+    size_t kept = 0;
+    for (auto &data_file : data_files) {
+        if (data_file.first <= lsn) {
+            std::filesystem::remove(data_file.second);
+        } else {
+            data_files[kept++] = std::move(data_file);
+        }
+    }
+    data_files.resize(kept);
+}
+
+
+void Write_ahead_log::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        pending.wait(lock, [this] { return stopping || !buffer.empty(); });
+        if (buffer.empty()) {
+            return; // журнал закрывается, всё сброшено
+        }
+        // пока идёт интервал, к этому fsync присоединяются записи других команд
+        pending.wait_for(lock, interval, [this] { return stopping || buffer.size() >= flush_size; });
+
+        std::string data;
+        data.swap(buffer);
+        uint64_t lsn = next_lsn - 1;
+        flushing = true;
+        lock.unlock();
+        write_all(fd, data);
+        if (fdatasync(fd) == -1) {
+            std::cerr << "Can't sync the log! Quitting" << std::endl;
+            std::abort();
+        }
+        lock.lock();
+        flushing = false;
+        file_size += data.size();
+        durable_lsn = lsn;
+        durable.notify_all();
+        auto ready = take_durable();
+        lock.unlock();
+        for (auto &done : ready) {
+            done(); // вызываются без блокировки: они могут снова обращаться к журналу
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,141 @@
+#ifndef SQL_INTERPRETER_WAL_H
+#define SQL_INTERPRETER_WAL_H
+
+#include <cstddef>            // size_t
+#include <cstdint>            // uint64_t, uint32_t
+#include <string>             // std::string
+#include <string_view>        // std::string_view
+#include <functional>         // std::function
+#include <chrono>             // std::chrono::microseconds
+#include <mutex>              // std::mutex
+#include <condition_variable> // std::condition_variable
+#include <thread>             // std::thread
+#include <vector>             // std::vector
+#include <utility>            // std::pair
+
+/* ------------------------------------------------ */
+/* ---------------------- WAL --------------------- */
+/* ------------------------------------------------ */
+
+/**
+ * [NB!] журнал предзаписи: текст каждой выполненной команды, изменившей данные, дописывается
+ *       в журнал под блокировкой её таблицы (поэтому порядок записей совпадает с порядком
+ *       изменений), а на диск журнал сбрасывает отдельный поток: одним fsync сразу за всех,
+ *       кто успел дописать свои записи за интервал сброса (групповая фиксация);
+ *       запись: [u64 номер (LSN)][u32 длина команды][u32 CRC32 номера, длины и команды][команда];
+ *       COPY записывается вместе с данными файла ("COPY <таблица> FROM DATA;\n<строки CSV>"),
+ *       чтобы повтор журнала не зависел от файла, который к тому времени мог измениться;
+ *       данные длиннее INLINE_DATA_SIZE пишутся не в запись, а в свой файл <имя>.data.<номер>:
+ *       он сбрасывается на диск до того, как запись попадёт в журнал, а в записи (с битом DATA_FILE
+ *       в длине) после команды стоят [u64 номер файла][u64 длина данных][u32 CRC32 данных];
+ *       контрольная точка начинает новый файл журнала, а прежние файлы <имя>.<LSN последней записи>
+ *       и файлы данных их записей удаляются, только когда она дошла до диска (фоновая точка
+ *       пишется долго, а журнал не ждёт)
+ */
+class Write_ahead_log
+{
+public:
+    static constexpr uint32_t DATA_FILE = 1u << 31;          // бит длины: данные записи в своём файле
+    static constexpr size_t MAX_RECORD_SIZE = DATA_FILE - 1;  // длина команды в записи - u32 без этого бита
+    static constexpr size_t INLINE_DATA_SIZE = 1u << 20;      // данные длиннее пишутся в свой файл
+
+    /**
+     * [destructor: flushes the log and stops the flushing thread]
+     */
+    ~Write_ahead_log();
+
+    /**
+     * [open: replays with <apply>(command, data) the records of the file <file_name> newer than  ]
+     * [      <checkpoint_lsn>, cuts off a torn tail and starts appending to the file; the log is]
+     * [      flushed every <interval> or as soon as <flush_size> bytes are waiting; an exception]
+     * [      of <apply> stops the replay and leaves the log closed; <data> is empty unless the  ]
+     * [      record keeps its data in a file (then it is mapped from there)                    ]
+     */
+    void open(const std::string &file_name, uint64_t checkpoint_lsn,
+              const std::function<void(std::string_view, std::string_view)> &apply,
+              std::chrono::microseconds interval, size_t flush_size);
+
+    /**
+     * [append: appends the <command> followed by the <data> to the log as one record and returns]
+     * [        its LSN (0 if the log is not open: then nothing is checked or copied); the data ]
+     * [        longer than INLINE_DATA_SIZE is written to its own file outside the log lock    ]
+     */
+    uint64_t append(std::string_view command, std::string_view data = std::string_view());
+
+    /**
+     * [wait: blocks until the record <lsn> and all before it are on disk]
+     */
+    void wait(uint64_t lsn);
+
+    /**
+     * [when_durable: calls <done> as soon as the record <lsn> and all before it are on disk:]
+     * [              at once if they already are, otherwise from the flushing thread        ]
+     */
+    void when_durable(uint64_t lsn, std::function<void()> done);
+
+    /**
+     * [last_lsn: returns the LSN of the last appended record]
+     */
+    uint64_t last_lsn();
+
+    /**
+     * [rotate: starts a new log file for the records after last_lsn() and returns last_lsn();]
+     * [        the previous file is kept as <file_name>.<LSN> until remove_segments()          ]
+     */
+    uint64_t rotate();
+
+    /**
+     * [remove_segments: removes the previous log files with records up to <lsn> only]
+     * [                 (a checkpoint of <lsn> has reached the disk)                 ]
+     */
+    void remove_segments(uint64_t lsn);
+
+private:
+    std::mutex mutex;
+    std::condition_variable pending;  // появились записи для сброса (или журнал закрывается)
+    std::condition_variable durable;  // <durable_lsn> вырос
+    std::thread flusher;              // поток, сбрасывающий журнал на диск
+
+    std::string file_name;            // текущий файл журнала
+    int fd = -1;                      // его дескриптор (-1: журнал не открыт)
+    uint64_t file_size = 0;           // сколько байт уже в текущем файле
+    std::string buffer;               // записи, ещё не переданные в файл
+    uint64_t next_lsn = 1;            // номер следующей записи
+    uint64_t durable_lsn = 0;         // все записи до этого номера уже на диске
+    std::vector<std::pair<uint64_t, std::function<void()>>> waiters; // см. when_durable()
+    std::vector<std::pair<uint64_t, std::string>> data_files; // файлы данных и LSN их записей
+    uint64_t next_data = 1;           // номер следующего файла данных
+    bool flushing = false;            // поток сброса пишет в файл без блокировки <mutex>
+    bool stopping = false;
+    std::chrono::microseconds interval{2000};
+    size_t flush_size = 1u << 20;
+
+    /**
+     * [flush: body of the flushing thread]
+     */
+    void flush();
+
+    /**
+     * [append_file: writes the <data> to a new data file and appends the <command> referring to it]
+     */
+    uint64_t append_file(std::string_view command, std::string_view data);
+
+    /**
+     * [replay: applies with <apply> the records of the <file> newer than <checkpoint_lsn> and]
+     * [        returns the size of its intact part; <previous> and <last> are the LSN of the ]
+     * [        last read and the last applied record; the data files <log_name>.data.<number> ]
+     * [        of the applied records are noted in <data_files>                              ]
+     */
+    size_t replay(const std::string &file, const std::string &log_name, uint64_t checkpoint_lsn,
+                  const std::function<void(std::string_view, std::string_view)> &apply,
+                  uint64_t &previous, uint64_t &last);
+
+    /**
+     * [take_durable: removes from <waiters> the callbacks whose records are on disk (under <mutex>)]
+     */
+    std::vector<std::function<void()>> take_durable();
+}; // class Write_ahead_log
+
+extern Write_ahead_log wal; // журнал базы данных сервера
+
+#endif // SQL_INTERPRETER_WAL_H